@@ -0,0 +1,343 @@
+#include "Benchmarks.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <vector>
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include "DynamicVertexBuffer.h"
+#include "EntityRegistry.h"
+#include "EntitySystems.h"
+#include "Framebuffer.h"
+#include "GraphicsObject.h"
+#include "IndexBuffer.h"
+#include "Renderer.h"
+#include "Scene.h"
+#include "VertexBuffer.h"
+
+// Results are written here, so the compiler cannot drop the measured work
+static volatile float sink;
+
+// Best of a few runs, so one slow run from the OS does not count
+template <typename TRun>
+static double MeasureSeconds(int numberOfRuns, TRun run)
+{
+	double best = 0;
+	for (int i = 0; i < numberOfRuns; i++) {
+		auto start = std::chrono::steady_clock::now();
+		run();
+		double seconds = std::chrono::duration<double>(
+			std::chrono::steady_clock::now() - start).count();
+		if (i == 0 || seconds < best) {
+			best = seconds;
+		}
+	}
+	return best;
+}
+
+bool Benchmarks::Run(const std::string& name, std::ostream& report)
+{
+	if (name == "ingest") {
+		VertexIngestion(report);
+	}
+	else if (name == "vertex-cache") {
+		VertexCache(report);
+	}
+	else if (name == "transforms") {
+		TransformUpdates(report);
+	}
+	else if (name == "streaming") {
+		Streaming(report);
+	}
+	else {
+		return false;
+	}
+	return true;
+}
+
+void Benchmarks::VertexIngestion(std::ostream& report)
+{
+	const unsigned int numberOfVertices = 1000000;
+	const int numberOfRuns = 5;
+	std::vector<VertexData> vertices(numberOfVertices);
+	for (unsigned int i = 0; i < numberOfVertices; i++) {
+		float x = static_cast<float>(i % 1000);
+		float y = static_cast<float>(i / 1000);
+		vertices[i] = { { x, y, 0.0f }, { x / 1000.0f, y / 1000.0f, 1.0f } };
+	}
+	std::span<const float> components(
+		reinterpret_cast<const float*>(vertices.data()), numberOfVertices * 6);
+
+	// A new buffer per run, so every path starts with no capacity
+	double variadic = MeasureSeconds(numberOfRuns, [&]() {
+		VertexBuffer buffer(6);
+		for (const VertexData& vertex : vertices) {
+			buffer.AddVertexData(6,
+				vertex.position.x, vertex.position.y, vertex.position.z,
+				vertex.color.r, vertex.color.g, vertex.color.b);
+		}
+	});
+	double typed = MeasureSeconds(numberOfRuns, [&]() {
+		VertexBuffer buffer(6);
+		buffer.AddVertices<VertexData>(vertices);
+	});
+	double floats = MeasureSeconds(numberOfRuns, [&]() {
+		VertexBuffer buffer(6);
+		buffer.AddVertices(components);
+	});
+
+	report << "Vertex ingestion, " << numberOfVertices << " VertexData, best of "
+		<< numberOfRuns << " runs\n";
+	auto line = [&](const char* path, double seconds) {
+		report << "  " << path << ": " << seconds * 1000.0 << " ms, "
+			<< numberOfVertices / seconds / 1e6 << " M vertices/s, "
+			<< variadic / seconds << "x variadic\n";
+	};
+	line("AddVertexData (variadic)", variadic);
+	line("AddVertices<VertexData>", typed);
+	line("AddVertices (floats)", floats);
+}
+
+// Optimizes a copy of the mesh and reports the cache and the time it took
+static void ReportVertexCache(
+	std::ostream& report, const char* mesh,
+	const std::vector<VertexData>& vertices, const std::vector<unsigned int>& indices)
+{
+	VertexBuffer buffer(6);
+	buffer.AddVertices<VertexData>(vertices);
+	if (!indices.empty()) {
+		auto indexBuffer = std::make_shared<IndexBuffer>();
+		indexBuffer->AddIndices(indices);
+		buffer.SetIndexBuffer(indexBuffer);
+	}
+	unsigned int numberOfTriangles = static_cast<unsigned int>(
+		(indices.empty() ? vertices.size() : indices.size()) / 3);
+	VertexCacheReport cache;
+	double seconds = MeasureSeconds(1, [&]() {
+		cache = buffer.OptimizeVertexCache();
+	});
+	report << "  " << mesh << ", " << numberOfTriangles << " triangles: ACMR "
+		<< cache.acmrBefore << " -> " << cache.acmrAfter << ", "
+		<< seconds * 1000.0 << " ms\n";
+}
+
+void Benchmarks::VertexCache(std::ostream& report)
+{
+	report << "Vertex cache optimization\n";
+
+	// A grid in scanline order, which is already fairly cache friendly
+	const unsigned int columns = 300;
+	std::vector<VertexData> gridVertices;
+	for (unsigned int y = 0; y <= columns; y++) {
+		for (unsigned int x = 0; x <= columns; x++) {
+			gridVertices.push_back({
+				{ static_cast<float>(x), static_cast<float>(y), 0.0f }, { 1.0f, 1.0f, 1.0f } });
+		}
+	}
+	std::vector<unsigned int> gridIndices;
+	for (unsigned int y = 0; y < columns; y++) {
+		for (unsigned int x = 0; x < columns; x++) {
+			unsigned int corner = y * (columns + 1) + x;
+			unsigned int above = corner + columns + 1;
+			gridIndices.insert(gridIndices.end(),
+				{ corner, corner + 1, above, corner + 1, above + 1, above });
+		}
+	}
+	ReportVertexCache(report, "Grid, scanline order", gridVertices, gridIndices);
+
+	// The same triangles in random order, as some exporters write them
+	std::vector<unsigned int> order(gridIndices.size() / 3);
+	for (unsigned int i = 0; i < order.size(); i++) {
+		order[i] = i;
+	}
+	std::shuffle(order.begin(), order.end(), std::mt19937(1));
+	std::vector<unsigned int> shuffledIndices;
+	for (unsigned int triangle : order) {
+		shuffledIndices.insert(shuffledIndices.end(), {
+			gridIndices[triangle * 3],
+			gridIndices[triangle * 3 + 1],
+			gridIndices[triangle * 3 + 2] });
+	}
+	ReportVertexCache(report, "Grid, shuffled", gridVertices, shuffledIndices);
+
+	// A UV sphere as a triangle soup, welded before it is optimized
+	const int stacks = 128;
+	const int slices = 256;
+	auto spherePoint = [&](int stack, int slice) {
+		float theta = glm::pi<float>() * stack / stacks;
+		float phi = glm::two_pi<float>() * (slice % slices) / slices;
+		glm::vec3 position(
+			std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+		return VertexData{ position, { 1.0f, 1.0f, 1.0f } };
+	};
+	std::vector<VertexData> sphereVertices;
+	for (int stack = 0; stack < stacks; stack++) {
+		for (int slice = 0; slice < slices; slice++) {
+			sphereVertices.insert(sphereVertices.end(), {
+				spherePoint(stack, slice), spherePoint(stack + 1, slice),
+				spherePoint(stack, slice + 1), spherePoint(stack, slice + 1),
+				spherePoint(stack + 1, slice), spherePoint(stack + 1, slice + 1) });
+		}
+	}
+	ReportVertexCache(report, "UV sphere, welded soup", sphereVertices, {});
+}
+
+// The world frames of a GraphicsObject subtree, as the renderer reads them
+static void ReadReferenceFrames(const GraphicsObject& object, glm::mat4& sum)
+{
+	sum += object.GetReferenceFrame();
+	for (const auto& child : object.GetChildren()) {
+		ReadReferenceFrames(*child, sum);
+	}
+}
+
+void Benchmarks::TransformUpdates(std::ostream& report)
+{
+	const unsigned int numberOfNodes = 1000000;
+	const int numberOfRuns = 5;
+	report << "Transform updates, " << numberOfNodes
+		<< " nodes in chains, every root moved, best of " << numberOfRuns << " runs\n";
+	const glm::mat4 step = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	for (unsigned int depth : { 1u, 4u, 16u, 64u }) {
+		unsigned int numberOfRoots = numberOfNodes / depth;
+		glm::mat4 sum(0.0f);
+
+		double graph;
+		{
+			std::vector<std::shared_ptr<GraphicsObject>> roots;
+			for (unsigned int i = 0; i < numberOfRoots; i++) {
+				roots.push_back(std::make_shared<GraphicsObject>());
+				GraphicsObject* end = roots.back().get();
+				for (unsigned int level = 1; level < depth; level++) {
+					auto child = std::make_shared<GraphicsObject>();
+					child->SetPosition(glm::vec3(0.0f, 1.0f, 0.0f));
+					end->AddChild(child);
+					end = child.get();
+				}
+			}
+			float x = 0.0f;
+			graph = MeasureSeconds(numberOfRuns, [&]() {
+				x += 1.0f;
+				for (auto& root : roots) {
+					root->SetPosition(glm::vec3(x, 0.0f, 0.0f));
+				}
+				for (auto& root : roots) {
+					ReadReferenceFrames(*root, sum);
+				}
+			});
+		}
+
+		double registry;
+		{
+			EntityRegistry entities;
+			entities.GetTransforms().Reserve(numberOfNodes);
+			std::vector<Entity> roots;
+			for (unsigned int i = 0; i < numberOfRoots; i++) {
+				roots.push_back(entities.Create());
+				entities.AddTransform(roots.back());
+				Entity end = roots.back();
+				for (unsigned int level = 1; level < depth; level++) {
+					Entity child = entities.Create();
+					entities.AddTransform(child, step, end);
+					end = child;
+				}
+			}
+			float x = 0.0f;
+			registry = MeasureSeconds(numberOfRuns, [&]() {
+				x += 1.0f;
+				for (Entity root : roots) {
+					entities.SetLocalMatrix(
+						root, glm::translate(glm::mat4(1.0f), glm::vec3(x, 0.0f, 0.0f)));
+				}
+				EntitySystems::UpdateTransforms(entities);
+				for (const TransformComponent& transform :
+					entities.GetTransforms().GetComponents()) {
+					sum += transform.world;
+				}
+			});
+		}
+
+		report << "  depth " << depth << ": GraphicsObject graph " << graph * 1000.0
+			<< " ms, EntityRegistry " << registry * 1000.0 << " ms, "
+			<< graph / registry << "x\n";
+		sink = sum[3][1];
+	}
+}
+
+// A row of quads across clip space whose heights follow a moving wave
+static void BuildWave(std::vector<VertexData>& vertices, unsigned int numberOfQuads, float phase)
+{
+	vertices.clear();
+	float width = 2.0f / numberOfQuads;
+	for (unsigned int i = 0; i < numberOfQuads; i++) {
+		float left = -1.0f + i * width;
+		float right = left + width;
+		float top = 0.5f * std::sin(left * 8.0f + phase);
+		glm::vec3 color(0.5f + top, 0.5f, 1.0f);
+		vertices.insert(vertices.end(), {
+			{ { left, top, 0.0f }, color }, { { left, -0.9f, 0.0f }, color },
+			{ { right, -0.9f, 0.0f }, color }, { { left, top, 0.0f }, color },
+			{ { right, -0.9f, 0.0f }, color }, { { right, top, 0.0f }, color } });
+	}
+}
+
+// Seconds per frame for rebuilding the wave and rendering it from buffer;
+// ring is the same buffer when it is a DynamicVertexBuffer
+static double MeasureStreaming(
+	const std::shared_ptr<VertexBuffer>& buffer, DynamicVertexBuffer* ring,
+	unsigned int numberOfQuads, int numberOfFrames)
+{
+	// The default shader draws each object with its own uniform block
+	Renderer renderer(std::make_shared<Shader>());
+	std::shared_ptr<Scene> scene = std::make_shared<Scene>();
+	std::shared_ptr<GraphicsObject> wave = std::make_shared<GraphicsObject>();
+	std::vector<VertexData> vertices;
+	BuildWave(vertices, numberOfQuads, 0.0f);
+	buffer->AddVertices<VertexData>(vertices);
+	buffer->SetLayout<VertexDataLayout>();
+	wave->SetVertexBuffer(buffer);
+	scene->AddObject(wave);
+
+	Framebuffer target(1200, 800);
+	target.Select();
+	glViewport(0, 0, target.GetWidth(), target.GetHeight());
+	renderer.SetViewport(target.GetWidth(), target.GetHeight());
+	// Never allocated up front, so the first frame creates the storage
+	// through the renderer's upload, as for objects added later
+	renderer.RenderScene(scene, glm::mat4(1.0f));
+	double seconds = MeasureSeconds(1, [&]() {
+		for (int frame = 0; frame < numberOfFrames; frame++) {
+			BuildWave(vertices, numberOfQuads, frame * 0.05f);
+			buffer->SetVertices<VertexData>(0, vertices);
+			if (ring != nullptr) {
+				ring->Upload();
+			}
+			renderer.RenderScene(scene, glm::mat4(1.0f));
+		}
+		// Count the GPU's work too, not only the submission
+		glFinish();
+	});
+	target.Deselect();
+	return seconds / numberOfFrames;
+}
+
+void Benchmarks::Streaming(std::ostream& report)
+{
+	const unsigned int numberOfQuads = 20000;
+	const unsigned int numberOfVertices = numberOfQuads * 6;
+	const int numberOfFrames = 300;
+	report << "Streaming, " << numberOfVertices << " vertices rebuilt per frame, "
+		<< numberOfFrames << " frames\n";
+
+	auto ring = std::make_shared<DynamicVertexBuffer>(6, numberOfVertices);
+	double dynamic = MeasureStreaming(ring, ring.get(), numberOfQuads, numberOfFrames);
+	report << "  DynamicVertexBuffer, 3 regions: " << dynamic * 1000.0 << " ms/frame, "
+		<< ring->GetNumberOfFenceWaits() << " fence waits\n";
+
+	auto buffer = std::make_shared<VertexBuffer>(6);
+	double subData = MeasureStreaming(buffer, nullptr, numberOfQuads, numberOfFrames);
+	report << "  VertexBuffer, glBufferSubData: " << subData * 1000.0 << " ms/frame, "
+		<< subData / dynamic << "x the ring\n";
+}
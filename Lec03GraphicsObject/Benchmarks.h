@@ -0,0 +1,27 @@
+#pragma once
+#include <ostream>
+#include <string>
+
+// Measurements run with --benchmark <name> on the headless context; each
+// writes its results to the report
+class Benchmarks
+{
+public:
+	// Returns false when there is no benchmark of that name
+	static bool Run(const std::string& name, std::ostream& report);
+
+	// "ingest": vertices per second through the variadic AddVertexData
+	// and the bulk AddVertices paths
+	static void VertexIngestion(std::ostream& report);
+	// "vertex-cache": ACMR before and after OptimizeVertexCache, and its
+	// time, on a grid in scanline and shuffled order and on a UV sphere
+	static void VertexCache(std::ostream& report);
+	// "transforms": moving every root of 1M nodes and updating the world
+	// matrices, in the GraphicsObject graph and in an EntityRegistry,
+	// with the nodes in chains of several depths
+	static void TransformUpdates(std::ostream& report);
+	// "streaming": a wave of quads rebuilt every frame and drawn offscreen
+	// through the renderer, from a DynamicVertexBuffer ring and from a
+	// VertexBuffer whose vertices are sent again with glBufferSubData
+	static void Streaming(std::ostream& report);
+};
@@ -0,0 +1,184 @@
+#include "Bounds.h"
+#include <algorithm>
+
+void BoundingBox::Include(const glm::vec3& point)
+{
+	if (IsEmpty()) {
+		min = point;
+		max = point;
+		return;
+	}
+	min = glm::min(min, point);
+	max = glm::max(max, point);
+}
+
+void BoundingBox::Include(const BoundingBox& box)
+{
+	if (box.IsEmpty()) {
+		return;
+	}
+	Include(box.min);
+	Include(box.max);
+}
+
+BoundingBox BoundingBox::Transform(const glm::mat4& matrix) const
+{
+	if (IsEmpty()) {
+		return *this;
+	}
+	// Each extent axis moves the corners by the absolute matrix column
+	glm::vec3 center = glm::vec3(matrix * glm::vec4(GetCenter(), 1.0f));
+	glm::vec3 extents = GetExtents();
+	glm::vec3 newExtents =
+		glm::abs(glm::vec3(matrix[0])) * extents.x +
+		glm::abs(glm::vec3(matrix[1])) * extents.y +
+		glm::abs(glm::vec3(matrix[2])) * extents.z;
+	BoundingBox box;
+	box.min = center - newExtents;
+	box.max = center + newExtents;
+	return box;
+}
+
+bool BoundingBox::Overlaps(const BoundingBox& box) const
+{
+	if (IsEmpty() || box.IsEmpty()) {
+		return false;
+	}
+	return glm::all(glm::lessThanEqual(min, box.max)) &&
+		glm::all(glm::lessThanEqual(box.min, max));
+}
+
+bool BoundingBox::Contains(const glm::vec3& point) const
+{
+	return glm::all(glm::lessThanEqual(min, point)) &&
+		glm::all(glm::lessThanEqual(point, max));
+}
+
+bool BoundingBox::Contains(const BoundingBox& box) const
+{
+	if (IsEmpty() || box.IsEmpty()) {
+		return false;
+	}
+	return glm::all(glm::lessThanEqual(min, box.min)) &&
+		glm::all(glm::lessThanEqual(box.max, max));
+}
+
+float BoundingBox::DistanceSquared(const glm::vec3& point) const
+{
+	glm::vec3 offset = glm::max(glm::max(min - point, point - max), glm::vec3(0.0f));
+	return glm::dot(offset, offset);
+}
+
+float BoundingBox::GetHalfArea() const
+{
+	if (IsEmpty()) {
+		return 0.0f;
+	}
+	glm::vec3 size = max - min;
+	return size.x * size.y + size.y * size.z + size.z * size.x;
+}
+
+bool BoundingBox::Intersects(const Ray& ray, float maxDistance, float& distance) const
+{
+	if (IsEmpty()) {
+		return false;
+	}
+	// Slab test; an axis the ray runs parallel to gives infinite distances,
+	// or NaN when the ray lies in the slab's face, which the order of the
+	// min and max below ignores
+	float entry = 0.0f;
+	float exit = maxDistance;
+	for (int axis = 0; axis < 3; axis++) {
+		float inverse = 1.0f / ray.direction[axis];
+		float entryOnAxis = (min[axis] - ray.origin[axis]) * inverse;
+		float exitOnAxis = (max[axis] - ray.origin[axis]) * inverse;
+		if (entryOnAxis > exitOnAxis) {
+			std::swap(entryOnAxis, exitOnAxis);
+		}
+		entry = std::max(entry, entryOnAxis);
+		exit = std::min(exit, exitOnAxis);
+		if (entry > exit) {
+			return false;
+		}
+	}
+	distance = entry;
+	return true;
+}
+
+BoundingSphere BoundingSphere::Transform(const glm::mat4& matrix) const
+{
+	if (IsEmpty()) {
+		return *this;
+	}
+	float scale = std::max({
+		glm::length(glm::vec3(matrix[0])),
+		glm::length(glm::vec3(matrix[1])),
+		glm::length(glm::vec3(matrix[2])) });
+	return { glm::vec3(matrix * glm::vec4(center, 1.0f)), radius * scale };
+}
+
+Frustum::Frustum(const glm::mat4& viewProjection)
+{
+	// Each plane is the fourth row plus or minus one of the others
+	glm::mat4 rows = glm::transpose(viewProjection);
+	planes[0] = rows[3] + rows[0];
+	planes[1] = rows[3] - rows[0];
+	planes[2] = rows[3] + rows[1];
+	planes[3] = rows[3] - rows[1];
+	planes[4] = rows[3] + rows[2];
+	planes[5] = rows[3] - rows[2];
+	for (auto& plane : planes) {
+		plane /= glm::length(glm::vec3(plane));
+	}
+}
+
+bool Frustum::Intersects(const BoundingBox& box) const
+{
+	if (box.IsEmpty()) {
+		return false;
+	}
+	glm::vec3 center = box.GetCenter();
+	glm::vec3 extents = box.GetExtents();
+	for (const auto& plane : planes) {
+		glm::vec3 normal = glm::vec3(plane);
+		// The distance of the corner furthest along the normal
+		float distance = glm::dot(normal, center) +
+			glm::dot(glm::abs(normal), extents) + plane.w;
+		if (distance < -planeTolerance) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool Frustum::Intersects(const BoundingSphere& sphere) const
+{
+	if (sphere.IsEmpty()) {
+		return false;
+	}
+	for (const auto& plane : planes) {
+		if (glm::dot(glm::vec3(plane), sphere.center) + plane.w < -sphere.radius - planeTolerance) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool Frustum::Contains(const BoundingBox& box) const
+{
+	if (box.IsEmpty()) {
+		return false;
+	}
+	glm::vec3 center = box.GetCenter();
+	glm::vec3 extents = box.GetExtents();
+	for (const auto& plane : planes) {
+		glm::vec3 normal = glm::vec3(plane);
+		// The distance of the corner furthest against the normal
+		float distance = glm::dot(normal, center) -
+			glm::dot(glm::abs(normal), extents) + plane.w;
+		if (distance < -planeTolerance) {
+			return false;
+		}
+	}
+	return true;
+}
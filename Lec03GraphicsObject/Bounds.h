@@ -0,0 +1,69 @@
+#pragma once
+#include <glm/glm.hpp>
+
+// A half-line; distances along it count lengths of direction, which are
+// world units when direction is of unit length
+struct Ray {
+	glm::vec3 origin;
+	glm::vec3 direction;
+
+	inline glm::vec3 GetPoint(float distance) const { return origin + direction * distance; }
+};
+
+// Axis-aligned box; empty until a point is included
+struct BoundingBox {
+	glm::vec3 min = glm::vec3(1.0f);
+	glm::vec3 max = glm::vec3(-1.0f);
+
+	inline bool IsEmpty() const { return min.x > max.x; }
+	inline glm::vec3 GetCenter() const { return (min + max) * 0.5f; }
+	inline glm::vec3 GetExtents() const { return (max - min) * 0.5f; }
+
+	void Include(const glm::vec3& point);
+	void Include(const BoundingBox& box);
+	// The box around this box after the transform
+	BoundingBox Transform(const glm::mat4& matrix) const;
+
+	bool Overlaps(const BoundingBox& box) const;
+	bool Contains(const glm::vec3& point) const;
+	bool Contains(const BoundingBox& box) const;
+	// Zero inside the box
+	float DistanceSquared(const glm::vec3& point) const;
+	// Half the surface area, which is all that comparing costs needs
+	float GetHalfArea() const;
+	// Whether the ray enters the box within maxDistance, and where; 0 when
+	// the ray starts inside
+	bool Intersects(const Ray& ray, float maxDistance, float& distance) const;
+};
+
+struct BoundingSphere {
+	glm::vec3 center = glm::vec3(0.0f);
+	// Negative when empty
+	float radius = -1.0f;
+
+	inline bool IsEmpty() const { return radius < 0.0f; }
+
+	// The sphere around this sphere after the transform, which may scale
+	BoundingSphere Transform(const glm::mat4& matrix) const;
+};
+
+// The six planes of a view volume, pointing inwards
+class Frustum
+{
+private:
+	glm::vec4 planes[6];
+
+public:
+	// How far outside a plane still counts as touching it, so that boxes
+	// lying exactly on a plane are not lost to rounding
+	static constexpr float planeTolerance = 1e-4f;
+
+	// Extracts the planes of the volume a view-projection matrix maps to
+	// clip space, for orthographic and perspective projections alike
+	Frustum(const glm::mat4& viewProjection);
+
+	bool Intersects(const BoundingBox& box) const;
+	bool Intersects(const BoundingSphere& sphere) const;
+	// True when the whole box is inside
+	bool Contains(const BoundingBox& box) const;
+};
@@ -0,0 +1,174 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+// A handle to an entity: the slot it lives in plus the slot's generation
+// when it was created. Destroying the entity bumps the generation, so old
+// handles stop matching whatever reuses the slot.
+struct Entity {
+	static constexpr std::uint32_t invalidIndex =
+		std::numeric_limits<std::uint32_t>::max();
+
+	std::uint32_t index = invalidIndex;
+	std::uint32_t generation = 0;
+
+	inline bool IsNull() const { return index == invalidIndex; }
+	bool operator==(const Entity& other) const = default;
+
+	// The handle as one number, e.g. for storing it as a spatial index item
+	inline std::uint64_t GetKey() const {
+		return (static_cast<std::uint64_t>(generation) << 32) | index;
+	}
+	static inline Entity FromKey(std::uint64_t key) {
+		return { static_cast<std::uint32_t>(key), static_cast<std::uint32_t>(key >> 32) };
+	}
+};
+
+// Components of one type as a sparse set. The components and their
+// entities are packed in dense arrays that systems walk in order; the
+// sparse array maps an entity's slot to its dense position. Add, Remove
+// and Find are O(1). Remove moves the last component into the hole.
+template <typename TComponent>
+class ComponentPool
+{
+private:
+	static constexpr std::uint32_t absent = std::numeric_limits<std::uint32_t>::max();
+
+	std::vector<std::uint32_t> sparse;
+	std::vector<Entity> entities;
+	std::vector<TComponent> components;
+
+public:
+	inline std::size_t GetSize() const { return components.size(); }
+	inline const std::vector<Entity>& GetEntities() const { return entities; }
+	inline std::vector<TComponent>& GetComponents() { return components; }
+	inline const std::vector<TComponent>& GetComponents() const { return components; }
+
+	void Reserve(std::size_t count);
+	bool Has(Entity entity) const;
+	// Replaces the component if the entity already has one
+	TComponent& Add(Entity entity, const TComponent& component);
+	// Does nothing if the entity has no such component
+	void Remove(Entity entity);
+	// nullptr if the entity has no such component
+	TComponent* Find(Entity entity);
+	const TComponent* Find(Entity entity) const;
+	// Throws if the entity has no such component
+	TComponent& Get(Entity entity);
+	// The entity's position in the dense arrays; throws if it has none
+	std::uint32_t GetPosition(Entity entity) const;
+	// Reorders the dense arrays, keeping equal components in their order
+	template <typename TCompare>
+	void Sort(TCompare isBefore);
+};
+
+template <typename TComponent>
+void ComponentPool<TComponent>::Reserve(std::size_t count)
+{
+	entities.reserve(count);
+	components.reserve(count);
+}
+
+template <typename TComponent>
+bool ComponentPool<TComponent>::Has(Entity entity) const
+{
+	return entity.index < sparse.size() && sparse[entity.index] != absent &&
+		entities[sparse[entity.index]] == entity;
+}
+
+template <typename TComponent>
+TComponent& ComponentPool<TComponent>::Add(Entity entity, const TComponent& component)
+{
+	if (entity.IsNull()) {
+		throw "Cannot add a component to a null entity!";
+	}
+	if (Has(entity)) {
+		TComponent& existing = components[sparse[entity.index]];
+		existing = component;
+		return existing;
+	}
+	if (entity.index >= sparse.size()) {
+		sparse.resize(static_cast<std::size_t>(entity.index) + 1, absent);
+	}
+	sparse[entity.index] = static_cast<std::uint32_t>(components.size());
+	entities.push_back(entity);
+	components.push_back(component);
+	return components.back();
+}
+
+template <typename TComponent>
+void ComponentPool<TComponent>::Remove(Entity entity)
+{
+	if (!Has(entity)) {
+		return;
+	}
+	std::uint32_t position = sparse[entity.index];
+	std::uint32_t lastPosition = static_cast<std::uint32_t>(components.size() - 1);
+	if (position != lastPosition) {
+		entities[position] = entities[lastPosition];
+		components[position] = std::move(components[lastPosition]);
+		sparse[entities[position].index] = position;
+	}
+	entities.pop_back();
+	components.pop_back();
+	sparse[entity.index] = absent;
+}
+
+template <typename TComponent>
+TComponent* ComponentPool<TComponent>::Find(Entity entity)
+{
+	return Has(entity) ? &components[sparse[entity.index]] : nullptr;
+}
+
+template <typename TComponent>
+const TComponent* ComponentPool<TComponent>::Find(Entity entity) const
+{
+	return Has(entity) ? &components[sparse[entity.index]] : nullptr;
+}
+
+template <typename TComponent>
+TComponent& ComponentPool<TComponent>::Get(Entity entity)
+{
+	if (!Has(entity)) {
+		throw "Entity does not have this component!";
+	}
+	return components[sparse[entity.index]];
+}
+
+template <typename TComponent>
+std::uint32_t ComponentPool<TComponent>::GetPosition(Entity entity) const
+{
+	if (!Has(entity)) {
+		throw "Entity does not have this component!";
+	}
+	return sparse[entity.index];
+}
+
+template <typename TComponent>
+template <typename TCompare>
+void ComponentPool<TComponent>::Sort(TCompare isBefore)
+{
+	std::vector<std::uint32_t> order(components.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(),
+		[&](std::uint32_t a, std::uint32_t b) {
+			return isBefore(components[a], components[b]);
+		});
+
+	std::vector<Entity> sortedEntities;
+	std::vector<TComponent> sortedComponents;
+	sortedEntities.reserve(order.size());
+	sortedComponents.reserve(order.size());
+	for (std::uint32_t position : order) {
+		sparse[entities[position].index] =
+			static_cast<std::uint32_t>(sortedEntities.size());
+		sortedEntities.push_back(entities[position]);
+		sortedComponents.push_back(std::move(components[position]));
+	}
+	entities = std::move(sortedEntities);
+	components = std::move(sortedComponents);
+}
@@ -0,0 +1,139 @@
+#include "DynamicVertexBuffer.h"
+#include <cstring>
+
+DynamicVertexBuffer::DynamicVertexBuffer(
+	unsigned int numElementsPerVertex, unsigned int maxVerticesPerFrame,
+	unsigned int numberOfRegions)
+	: VertexBuffer(numElementsPerVertex)
+{
+	verticesPerRegion = maxVerticesPerFrame;
+	this->numberOfRegions = numberOfRegions;
+	currentRegion = 0;
+	isRingCreated = false;
+	mappedData = nullptr;
+	regionFences.resize(numberOfRegions, nullptr);
+	numberOfFenceWaits = 0;
+	waitedLastUpload = false;
+}
+
+DynamicVertexBuffer::~DynamicVertexBuffer()
+{
+	for (GLsync fence : regionFences) {
+		if (fence != nullptr) {
+			glDeleteSync(fence);
+		}
+	}
+	// Deleting the buffer in ~VertexBuffer also unmaps it
+}
+
+void DynamicVertexBuffer::StaticAllocate()
+{
+	if (isRingCreated) {
+		return;
+	}
+	unsigned long long bytesToAllocate = GetRegionSizeInBytes() * numberOfRegions;
+	SetGpuAccounting(static_cast<long long>(bytesToAllocate));
+	if (GLAD_GL_VERSION_4_4) {
+		// Immutable storage that stays mapped for the life of the buffer;
+		// coherent mapping makes CPU writes visible without flushing
+		GLbitfield flags = 
+			GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_ARRAY_BUFFER, bytesToAllocate, nullptr, flags);
+		mappedData = static_cast<unsigned char*>(
+			glMapBufferRange(GL_ARRAY_BUFFER, 0, bytesToAllocate, flags));
+	}
+	else {
+		// Without buffer storage each region is mapped unsynchronized on
+		// upload; the fences still provide the synchronization
+		glBufferData(GL_ARRAY_BUFFER, bytesToAllocate, nullptr, GL_STREAM_DRAW);
+	}
+	numberOfAllocatedVertices = numberOfVertices;
+	RecordVertexArray();
+	isRingCreated = true;
+}
+
+void DynamicVertexBuffer::Upload()
+{
+	if (numberOfVertices > verticesPerRegion) {
+		throw "Too many vertices for the dynamic buffer region!";
+	}
+	if (!isRingCreated) {
+		Select();
+		StaticAllocate();
+		Deselect();
+	}
+	// Everything drawn from the region used last frame has been issued by
+	// now, so fence it before moving on
+	if (regionFences[currentRegion] != nullptr) {
+		glDeleteSync(regionFences[currentRegion]);
+	}
+	regionFences[currentRegion] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	currentRegion = (currentRegion + 1) % numberOfRegions;
+	WaitForRegion(currentRegion);
+
+	unsigned long long regionOffset = GetRegionSizeInBytes() * currentRegion;
+	unsigned long long bytesToCopy = vertexData.size();
+	if (mappedData != nullptr) {
+		std::memcpy(mappedData + regionOffset, vertexData.data(), bytesToCopy);
+	}
+	else if (bytesToCopy > 0) {
+		Select();
+		void* region = glMapBufferRange(
+			GL_ARRAY_BUFFER, regionOffset, bytesToCopy,
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | 
+			GL_MAP_UNSYNCHRONIZED_BIT);
+		// A failed mapping leaves the region as it was
+		if (region != nullptr) {
+			std::memcpy(region, vertexData.data(), bytesToCopy);
+			glUnmapBuffer(GL_ARRAY_BUFFER);
+		}
+		Deselect();
+	}
+	firstVertex = verticesPerRegion * currentRegion;
+	numberOfAllocatedVertices = numberOfVertices;
+	dirtyRanges.clear();
+}
+
+unsigned long long DynamicVertexBuffer::UploadDirtyRanges()
+{
+	StaticAllocate();
+	numberOfAllocatedVertices = numberOfVertices;
+	dirtyRanges.clear();
+	return 0;
+}
+
+void DynamicVertexBuffer::RecreateAfterContextLoss()
+{
+	// The fences and the mapping went with the context
+	for (GLsync& fence : regionFences) {
+		fence = nullptr;
+	}
+	mappedData = nullptr;
+	isRingCreated = false;
+	currentRegion = 0;
+	firstVertex = 0;
+	VertexBuffer::RecreateAfterContextLoss();
+}
+
+void DynamicVertexBuffer::WaitForRegion(unsigned int region)
+{
+	waitedLastUpload = false;
+	GLsync fence = regionFences[region];
+	if (fence == nullptr) {
+		return;
+	}
+	GLenum result = glClientWaitSync(fence, 0, 0);
+	if (result == GL_TIMEOUT_EXPIRED) {
+		// The GPU is still reading this region, the CPU has to stall
+		waitedLastUpload = true;
+		numberOfFenceWaits++;
+		const GLuint64 oneMillisecond = 1000000;
+		do {
+			result = glClientWaitSync(
+				fence, GL_SYNC_FLUSH_COMMANDS_BIT, oneMillisecond);
+		} while (result == GL_TIMEOUT_EXPIRED);
+	}
+	glDeleteSync(fence);
+	regionFences[region] = nullptr;
+}
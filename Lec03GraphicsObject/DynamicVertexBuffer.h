@@ -0,0 +1,51 @@
+#pragma once
+#include <vector>
+#include "VertexBuffer.h"
+
+// A vertex buffer for geometry that changes every frame. The GL buffer is
+// split into regions used round-robin, one per frame, so the CPU fills
+// the next region while the GPU still reads the previous ones. A fence
+// per region stops the CPU from overwriting data the GPU has not drawn.
+class DynamicVertexBuffer : public VertexBuffer
+{
+protected:
+	unsigned int verticesPerRegion;
+	unsigned int numberOfRegions;
+	unsigned int currentRegion;
+	// Set once the GL storage exists; GL 4.4 storage cannot be respecified
+	bool isRingCreated;
+	// Non-null when the buffer is persistently mapped (GL 4.4)
+	unsigned char* mappedData;
+	std::vector<GLsync> regionFences;
+	unsigned int numberOfFenceWaits;
+	bool waitedLastUpload;
+
+public:
+	DynamicVertexBuffer(
+		unsigned int numElementsPerVertex, unsigned int maxVerticesPerFrame,
+		unsigned int numberOfRegions = 3);
+	~DynamicVertexBuffer();
+
+	inline unsigned int GetNumberOfFenceWaits() const { return numberOfFenceWaits; }
+	inline bool DidWaitLastUpload() const { return waitedLastUpload; }
+
+	// Creates the ring storage if it does not exist yet, the buffer must
+	// be selected
+	void StaticAllocate() override;
+	// Copies this frame's vertices into the next region, creating the
+	// ring first if needed. Call once per frame after the vertices were
+	// rebuilt and before rendering.
+	void Upload();
+	// The whole frame is copied by Upload, so this only creates the ring
+	// for buffers that were never allocated, e.g. added to a scene later
+	unsigned long long UploadDirtyRanges() override;
+	// Drops the mapping and fences of the lost context, then allocates
+	// the ring again; the next Upload refills it
+	void RecreateAfterContextLoss() override;
+
+private:
+	inline unsigned long long GetRegionSizeInBytes() const {
+		return static_cast<unsigned long long>(verticesPerRegion) * vertexSizeInBytes;
+	}
+	void WaitForRegion(unsigned int region);
+};
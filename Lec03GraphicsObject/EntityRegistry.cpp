@@ -0,0 +1,119 @@
+#include "EntityRegistry.h"
+#include "FrameInvalidation.h"
+
+EntityRegistry::EntityRegistry()
+{
+	numberOfEntities = 0;
+	isTransformOrderDirty = false;
+}
+
+Entity EntityRegistry::Create()
+{
+	Entity entity;
+	if (!freeIndices.empty()) {
+		entity.index = freeIndices.back();
+		freeIndices.pop_back();
+	}
+	else {
+		entity.index = static_cast<std::uint32_t>(generations.size());
+		generations.push_back(0);
+	}
+	entity.generation = generations[entity.index];
+	numberOfEntities++;
+	FrameInvalidation::Invalidate();
+	return entity;
+}
+
+Entity EntityRegistry::CreateDrawable(
+	VertexBuffer* mesh, const glm::mat4& local, Entity parent)
+{
+	Entity entity = Create();
+	AddTransform(entity, local, parent);
+	AddMesh(entity, mesh);
+	return entity;
+}
+
+void EntityRegistry::Destroy(Entity entity)
+{
+	if (!IsAlive(entity)) {
+		return;
+	}
+	if (transforms.Has(entity)) {
+		transforms.Remove(entity);
+		isTransformOrderDirty = true;
+	}
+	const BoundsComponent* entityBounds = bounds.Find(entity);
+	if (entityBounds != nullptr && entityBounds->proxy != SpatialIndex::nullNode) {
+		spatialIndex.Remove(entityBounds->proxy);
+	}
+	meshes.Remove(entity);
+	materials.Remove(entity);
+	bounds.Remove(entity);
+	visibilities.Remove(entity);
+	generations[entity.index]++;
+	freeIndices.push_back(entity.index);
+	numberOfEntities--;
+	FrameInvalidation::Invalidate();
+}
+
+bool EntityRegistry::IsAlive(Entity entity) const
+{
+	return entity.index < generations.size() &&
+		generations[entity.index] == entity.generation;
+}
+
+MeshComponent& EntityRegistry::AddMesh(Entity entity, VertexBuffer* mesh, unsigned int pass)
+{
+	if (!transforms.Has(entity)) {
+		throw "Entity has no transform!";
+	}
+	if (mesh == nullptr) {
+		throw "Entity mesh is null!";
+	}
+	// The bounds come from the next EntitySystems::UpdateBounds
+	const BoundsComponent* entityBounds = bounds.Find(entity);
+	int proxy = entityBounds != nullptr ? entityBounds->proxy : SpatialIndex::nullNode;
+	materials.Add(entity, { pass });
+	bounds.Add(entity, { BoundingBox(), BoundingSphere(), nullptr, 0, proxy });
+	visibilities.Add(entity, { false, false });
+	FrameInvalidation::Invalidate();
+	return meshes.Add(entity, { mesh });
+}
+
+TransformComponent& EntityRegistry::AddTransform(
+	Entity entity, const glm::mat4& local, Entity parent)
+{
+	if (transforms.Has(entity)) {
+		throw "Entity already has a transform!";
+	}
+	unsigned int depth = 0;
+	if (!parent.IsNull()) {
+		const TransformComponent* parentTransform = transforms.Find(parent);
+		if (parentTransform == nullptr) {
+			throw "Parent entity has no transform!";
+		}
+		depth = parentTransform->depth + 1;
+	}
+	// Appended after its parent, so the order stays valid
+	FrameInvalidation::Invalidate();
+	return transforms.Add(entity, { local, local, parent, depth, true, false });
+}
+
+void EntityRegistry::SetLocalMatrix(Entity entity, const glm::mat4& local)
+{
+	TransformComponent& transform = transforms.Get(entity);
+	transform.local = local;
+	transform.isDirty = true;
+	FrameInvalidation::Invalidate();
+}
+
+void EntityRegistry::SortTransforms()
+{
+	if (!isTransformOrderDirty) {
+		return;
+	}
+	transforms.Sort([](const TransformComponent& a, const TransformComponent& b) {
+		return a.depth < b.depth;
+	});
+	isTransformOrderDirty = false;
+}
@@ -0,0 +1,122 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Bounds.h"
+#include "ComponentPool.h"
+#include "SpatialIndex.h"
+
+class VertexBuffer;
+
+// Local and world matrices, the world matrix being recomputed by
+// EntitySystems::UpdateTransforms when the entity or its parent moved
+struct TransformComponent {
+	glm::mat4 local;
+	glm::mat4 world;
+	// Null for roots
+	Entity parent;
+	// Levels below the root; the pool is sorted by depth so parents are
+	// updated before their children
+	unsigned int depth;
+	bool isDirty;
+	// Set by the last update when the world matrix changed
+	bool isWorldChanged;
+};
+
+// The mesh an entity draws; the Scene's mesh list keeps it alive
+struct MeshComponent {
+	VertexBuffer* buffer;
+};
+
+// The render pass the entity's draws are sorted into
+struct MaterialComponent {
+	unsigned int pass;
+};
+
+struct BoundsComponent {
+	BoundingBox worldBox;
+	BoundingSphere worldSphere;
+	// The mesh and the mesh bounds version the world bounds came from
+	const VertexBuffer* mesh;
+	unsigned long long boundsVersion;
+	// Where the entity is in the registry's spatial index, nullNode if not
+	int proxy;
+};
+
+struct VisibilityComponent {
+	// Set by the application to leave the entity out
+	bool isHidden;
+	// Set by culling each frame
+	bool isVisible;
+};
+
+// Creates and destroys entities and stores their components. Slots of
+// destroyed entities are reused, so both take O(1).
+class EntityRegistry
+{
+private:
+	// Per slot, the generation of the entity in it or of the next one
+	std::vector<std::uint32_t> generations;
+	std::vector<std::uint32_t> freeIndices;
+	std::size_t numberOfEntities;
+	ComponentPool<TransformComponent> transforms;
+	// Added by AddMesh and removed by Destroy together, so the four pools
+	// stay in the same order: position i is the same entity in each, and
+	// systems walk them side by side. Never add or remove one alone.
+	ComponentPool<MeshComponent> meshes;
+	ComponentPool<MaterialComponent> materials;
+	ComponentPool<BoundsComponent> bounds;
+	ComponentPool<VisibilityComponent> visibilities;
+	// The world boxes of the entities with bounds, kept by
+	// EntitySystems::UpdateBounds
+	SpatialIndex spatialIndex;
+	// Set when a removal may have moved a child before its parent
+	bool isTransformOrderDirty;
+
+public:
+	EntityRegistry();
+	~EntityRegistry() = default;
+
+	inline std::size_t GetNumberOfEntities() const { return numberOfEntities; }
+	inline ComponentPool<TransformComponent>& GetTransforms() { return transforms; }
+	inline const ComponentPool<TransformComponent>& GetTransforms() const { return transforms; }
+	inline ComponentPool<MeshComponent>& GetMeshes() { return meshes; }
+	inline const ComponentPool<MeshComponent>& GetMeshes() const { return meshes; }
+	inline ComponentPool<MaterialComponent>& GetMaterials() { return materials; }
+	inline const ComponentPool<MaterialComponent>& GetMaterials() const { return materials; }
+	inline ComponentPool<BoundsComponent>& GetBounds() { return bounds; }
+	inline const ComponentPool<BoundsComponent>& GetBounds() const { return bounds; }
+	inline ComponentPool<VisibilityComponent>& GetVisibilities() { return visibilities; }
+	inline const ComponentPool<VisibilityComponent>& GetVisibilities() const {
+		return visibilities;
+	}
+	inline SpatialIndex& GetSpatialIndex() { return spatialIndex; }
+	inline const SpatialIndex& GetSpatialIndex() const { return spatialIndex; }
+
+	Entity Create();
+	// An entity with every component a drawn object needs
+	Entity CreateDrawable(
+		VertexBuffer* mesh, const glm::mat4& local = glm::mat4(1.0f),
+		Entity parent = Entity());
+	// Removes the entity's components and frees its slot. Its children
+	// become roots at their next transform update.
+	void Destroy(Entity entity);
+	bool IsAlive(Entity entity) const;
+	// Where the entity's mesh, material, bounds and visibility are in
+	// their pools; throws if it has no mesh
+	inline std::uint32_t GetDrawablePosition(Entity entity) const {
+		return meshes.GetPosition(entity);
+	}
+
+	// Adds the mesh with the material, bounds and visibility that every
+	// drawn entity has, so culling and picking can rely on them. Throws if
+	// the entity has no transform. Add meshes only through here.
+	MeshComponent& AddMesh(Entity entity, VertexBuffer* mesh, unsigned int pass = 0);
+	// Throws if the entity already has a transform or the parent has none
+	TransformComponent& AddTransform(
+		Entity entity, const glm::mat4& local = glm::mat4(1.0f),
+		Entity parent = Entity());
+	void SetLocalMatrix(Entity entity, const glm::mat4& local);
+	// Restores parent-before-child order after removals
+	void SortTransforms();
+};
@@ -0,0 +1,58 @@
+#include "EntitySystems.h"
+#include "VertexBuffer.h"
+
+void EntitySystems::UpdateTransforms(EntityRegistry& registry)
+{
+	registry.SortTransforms();
+	auto& transforms = registry.GetTransforms();
+	for (TransformComponent& transform : transforms.GetComponents()) {
+		const TransformComponent* parent = nullptr;
+		if (!transform.parent.IsNull()) {
+			parent = transforms.Find(transform.parent);
+			if (parent == nullptr) {
+				// The parent was destroyed
+				transform.parent = Entity();
+				transform.isDirty = true;
+			}
+		}
+		// Parents come first, so theirs is already this frame's matrix
+		if (transform.isDirty || (parent != nullptr && parent->isWorldChanged)) {
+			if (parent != nullptr) {
+				transform.world = parent->world * transform.local;
+			}
+			else {
+				transform.world = transform.local;
+			}
+			transform.isDirty = false;
+			transform.isWorldChanged = true;
+		}
+		else {
+			transform.isWorldChanged = false;
+		}
+	}
+}
+
+void EntitySystems::UpdateBounds(EntityRegistry& registry)
+{
+	// The mesh and bounds pools are in the same order
+	auto& bounds = registry.GetBounds();
+	const auto& entities = bounds.GetEntities();
+	auto& components = bounds.GetComponents();
+	const auto& meshes = registry.GetMeshes().GetComponents();
+	auto& transforms = registry.GetTransforms();
+	for (std::size_t i = 0; i < components.size(); i++) {
+		const TransformComponent& transform = transforms.Get(entities[i]);
+		BoundsComponent& entityBounds = components[i];
+		VertexBuffer* buffer = meshes[i].buffer;
+		if (transform.isWorldChanged || entityBounds.mesh != buffer ||
+			entityBounds.boundsVersion != buffer->GetBoundsVersion()) {
+			entityBounds.worldBox = buffer->GetBoundingBox().Transform(transform.world);
+			entityBounds.worldSphere =
+				buffer->GetBoundingSphere().Transform(transform.world);
+			entityBounds.mesh = buffer;
+			entityBounds.boundsVersion = buffer->GetBoundsVersion();
+			entityBounds.proxy = registry.GetSpatialIndex().Update(
+				entityBounds.proxy, entityBounds.worldBox, entities[i].GetKey());
+		}
+	}
+}
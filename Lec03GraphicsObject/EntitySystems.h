@@ -0,0 +1,15 @@
+#pragma once
+#include "EntityRegistry.h"
+
+// Per-frame passes over the dense component arrays of a registry
+class EntitySystems
+{
+public:
+	// Recomputes the world matrices of entities that moved or whose
+	// parent moved, in one pass; static entities cost a flag check
+	static void UpdateTransforms(EntityRegistry& registry);
+	// Recomputes the world bounds of entities whose world matrix or mesh
+	// bounds changed and moves them in the spatial index. Run after
+	// UpdateTransforms, and after the meshes' bounds were refreshed.
+	static void UpdateBounds(EntityRegistry& registry);
+};
@@ -0,0 +1,28 @@
+#pragma once
+#include <atomic>
+
+// Process-wide record of whether the next frame would look different from
+// the last one. Scene, buffer, camera and input changes invalidate it; the
+// main loop renders while frames are pending and otherwise waits for events.
+class FrameInvalidation
+{
+private:
+	static inline std::atomic<int> pendingFrames = 1;
+
+public:
+	// Asks for at least this many more frames, e.g. several after input so
+	// that ImGui, which reacts a frame late, settles
+	static inline void Invalidate(int frames = 1) {
+		int pending = pendingFrames.load();
+		while (pending < frames && !pendingFrames.compare_exchange_weak(pending, frames)) {
+		}
+	}
+	static inline bool IsDirty() { return pendingFrames.load() > 0; }
+	// Takes one pending frame; returns false when there is none to draw
+	static inline bool ConsumeFrame() {
+		int pending = pendingFrames.load();
+		while (pending > 0 && !pendingFrames.compare_exchange_weak(pending, pending - 1)) {
+		}
+		return pending > 0;
+	}
+};
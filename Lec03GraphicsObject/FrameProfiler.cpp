@@ -0,0 +1,126 @@
+#include "FrameProfiler.h"
+#include <algorithm>
+
+FrameProfiler::FrameProfiler() : frameMilliseconds(historySize, 0.0f)
+{
+	hasFrameStarted = false;
+	frameNumber = 0;
+	historyIndex = 0;
+}
+
+FrameProfiler::~FrameProfiler()
+{
+	for (auto& zone : zones) {
+		glDeleteQueries(static_cast<GLsizei>(zone.queries.size()), zone.queries.data());
+	}
+}
+
+void FrameProfiler::BeginFrame()
+{
+	if (hasFrameStarted) {
+		frameNumber++;
+		historyIndex = (historyIndex + 1) % historySize;
+	}
+	hasFrameStarted = true;
+	frameStart = std::chrono::steady_clock::now();
+	frameMilliseconds[historyIndex] = 0.0f;
+
+	// The slot is about to be reused, take what its queries measured
+	for (auto& zone : zones) {
+		ReadQueries(zone, GetSlot());
+		zone.cpuMilliseconds[historyIndex] = 0.0f;
+		zone.gpuMilliseconds[historyIndex] = 0.0f;
+	}
+}
+
+void FrameProfiler::EndFrame()
+{
+	frameMilliseconds[historyIndex] = std::chrono::duration<float, std::milli>(
+		std::chrono::steady_clock::now() - frameStart).count();
+}
+
+std::size_t FrameProfiler::BeginZone(const std::string& name)
+{
+	std::size_t index = FindZone(name);
+	ProfilerZone& zone = zones[index];
+	int slot = GetSlot();
+	// A slot still waiting on the GPU skips its GPU time this frame
+	if (zone.pendingHistoryIndex[slot] < 0) {
+		glQueryCounter(zone.queries[slot * 2], GL_TIMESTAMP);
+	}
+	zone.cpuStart = std::chrono::steady_clock::now();
+	return index;
+}
+
+void FrameProfiler::EndZone(std::size_t index)
+{
+	ProfilerZone& zone = zones[index];
+	zone.cpuMilliseconds[historyIndex] += std::chrono::duration<float, std::milli>(
+		std::chrono::steady_clock::now() - zone.cpuStart).count();
+	int slot = GetSlot();
+	if (zone.pendingHistoryIndex[slot] < 0) {
+		glQueryCounter(zone.queries[slot * 2 + 1], GL_TIMESTAMP);
+		zone.pendingHistoryIndex[slot] = static_cast<int>(historyIndex);
+	}
+}
+
+TimingSummary FrameProfiler::Summarize(const std::vector<float>& milliseconds)
+{
+	std::vector<float> samples;
+	samples.reserve(milliseconds.size());
+	for (float sample : milliseconds) {
+		if (sample > 0.0f) {
+			samples.push_back(sample);
+		}
+	}
+	if (samples.empty()) {
+		return { 0.0f, 0.0f, 0.0f };
+	}
+	auto percentile = [&samples](float fraction) {
+		std::size_t rank = static_cast<std::size_t>(fraction * (samples.size() - 1));
+		std::nth_element(samples.begin(), samples.begin() + rank, samples.end());
+		return samples[rank];
+	};
+	TimingSummary summary;
+	summary.p50 = percentile(0.50f);
+	summary.p99 = percentile(0.99f);
+	summary.max = *std::max_element(samples.begin(), samples.end());
+	return summary;
+}
+
+std::size_t FrameProfiler::FindZone(const std::string& name)
+{
+	for (std::size_t i = 0; i < zones.size(); i++) {
+		if (zones[i].name == name) {
+			return i;
+		}
+	}
+	ProfilerZone zone;
+	zone.name = name;
+	zone.cpuMilliseconds.assign(historySize, 0.0f);
+	zone.gpuMilliseconds.assign(historySize, 0.0f);
+	zone.queries.resize(numberOfFramesInFlight * 2);
+	glGenQueries(static_cast<GLsizei>(zone.queries.size()), zone.queries.data());
+	zone.pendingHistoryIndex.assign(numberOfFramesInFlight, -1);
+	zones.push_back(std::move(zone));
+	return zones.size() - 1;
+}
+
+void FrameProfiler::ReadQueries(ProfilerZone& zone, int slot)
+{
+	int pendingIndex = zone.pendingHistoryIndex[slot];
+	if (pendingIndex < 0) {
+		return;
+	}
+	GLint isAvailable = 0;
+	glGetQueryObjectiv(zone.queries[slot * 2 + 1], GL_QUERY_RESULT_AVAILABLE, &isAvailable);
+	if (!isAvailable) {
+		// Still in flight; BeginZone leaves the slot alone until it lands
+		return;
+	}
+	GLuint64 begin = 0, end = 0;
+	glGetQueryObjectui64v(zone.queries[slot * 2], GL_QUERY_RESULT, &begin);
+	glGetQueryObjectui64v(zone.queries[slot * 2 + 1], GL_QUERY_RESULT, &end);
+	zone.gpuMilliseconds[pendingIndex] = (end - begin) / 1.0e6f;
+	zone.pendingHistoryIndex[slot] = -1;
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include <glad/glad.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+// Percentiles of a zone's recorded frames, in milliseconds
+struct TimingSummary {
+	float p50;
+	float p99;
+	float max;
+};
+
+struct ProfilerZone {
+	std::string name;
+	// The last historySize frames, indexed like the frame history
+	std::vector<float> cpuMilliseconds;
+	std::vector<float> gpuMilliseconds;
+	std::chrono::steady_clock::time_point cpuStart;
+	// Begin and end timestamps for each frame in flight
+	std::vector<GLuint> queries;
+	// Where a slot's GPU time goes once its queries come back, -1 if idle
+	std::vector<int> pendingHistoryIndex;
+};
+
+// Times named zones of each frame on the CPU and, with GL_TIMESTAMP
+// queries, on the GPU. Query results are read numberOfFramesInFlight
+// frames later and only once available, so the profiler never stalls.
+class FrameProfiler
+{
+public:
+	static constexpr int numberOfFramesInFlight = 3;
+	static constexpr std::size_t historySize = 240;
+
+private:
+	std::vector<ProfilerZone> zones;
+	// Time from BeginFrame to EndFrame, so time spent idle between frames
+	// is left out
+	std::vector<float> frameMilliseconds;
+	std::chrono::steady_clock::time_point frameStart;
+	bool hasFrameStarted;
+	unsigned long long frameNumber;
+	std::size_t historyIndex;
+
+public:
+	FrameProfiler();
+	~FrameProfiler();
+
+	void BeginFrame();
+	void EndFrame();
+	// Returns the zone index to pass to EndZone
+	std::size_t BeginZone(const std::string& name);
+	void EndZone(std::size_t zone);
+
+	inline const std::vector<ProfilerZone>& GetZones() const { return zones; }
+	inline const std::vector<float>& GetFrameMilliseconds() const {
+		return frameMilliseconds;
+	}
+	// The oldest sample of the history rings, for plotting in order
+	inline std::size_t GetHistoryOffset() const { 
+		return (historyIndex + 1) % historySize; 
+	}
+	// Percentiles over the frames recorded so far; zero samples (frames
+	// where a zone did not run) are left out
+	static TimingSummary Summarize(const std::vector<float>& milliseconds);
+
+private:
+	std::size_t FindZone(const std::string& name);
+	// Collects the GPU times of the frame that last used this slot
+	void ReadQueries(ProfilerZone& zone, int slot);
+	inline int GetSlot() const {
+		return static_cast<int>(frameNumber % numberOfFramesInFlight);
+	}
+};
+
+// Times the enclosing block as a zone
+class ProfileScope
+{
+private:
+	FrameProfiler& profiler;
+	std::size_t zone;
+
+public:
+	ProfileScope(FrameProfiler& profiler, const std::string& name) :
+		profiler(profiler), zone(profiler.BeginZone(name)) {}
+	~ProfileScope() { profiler.EndZone(zone); }
+};
@@ -0,0 +1,36 @@
+#include "Framebuffer.h"
+
+Framebuffer::Framebuffer(int width, int height, GLenum colorFormat)
+{
+	this->width = width;
+	this->height = height;
+	glGenRenderbuffers(1, &colorRboId);
+	glBindRenderbuffer(GL_RENDERBUFFER, colorRboId);
+	glRenderbufferStorage(GL_RENDERBUFFER, colorFormat, width, height);
+	glGenRenderbuffers(1, &depthRboId);
+	glBindRenderbuffer(GL_RENDERBUFFER, depthRboId);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &fboId);
+	Select();
+	glFramebufferRenderbuffer(
+		GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorRboId);
+	glFramebufferRenderbuffer(
+		GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthRboId);
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	Deselect();
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		GLState::DeleteFramebuffer(fboId);
+		glDeleteRenderbuffers(1, &colorRboId);
+		glDeleteRenderbuffers(1, &depthRboId);
+		throw "Framebuffer is incomplete!";
+	}
+}
+
+Framebuffer::~Framebuffer()
+{
+	GLState::DeleteFramebuffer(fboId);
+	glDeleteRenderbuffers(1, &colorRboId);
+	glDeleteRenderbuffers(1, &depthRboId);
+}
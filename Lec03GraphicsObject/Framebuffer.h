@@ -0,0 +1,23 @@
+#pragma once
+#include <glad/glad.h>
+#include "GLState.h"
+
+// An offscreen render target: a color and a depth renderbuffer
+class Framebuffer
+{
+protected:
+	unsigned int fboId;
+	unsigned int colorRboId;
+	unsigned int depthRboId;
+	int width, height;
+
+public:
+	// Throws if the driver cannot render to this combination
+	Framebuffer(int width, int height, GLenum colorFormat = GL_RGBA8);
+	~Framebuffer();
+
+	inline void Select() { GLState::BindFramebuffer(fboId); }
+	inline void Deselect() { GLState::BindFramebuffer(0); }
+	inline int GetWidth() const { return width; }
+	inline int GetHeight() const { return height; }
+};
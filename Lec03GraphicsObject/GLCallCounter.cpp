@@ -0,0 +1,152 @@
+#include "GLCallCounter.h"
+#include <algorithm>
+#include <glad/glad.h>
+
+std::vector<GLCallCounter::Counter> GLCallCounter::counters;
+
+// One per glad pointer: counts the call, then makes it through the
+// pointer glad loaded
+template <auto pointer>
+struct CountedCall;
+
+template <typename TResult, typename... TArguments, TResult (APIENTRYP* pointer)(TArguments...)>
+struct CountedCall<pointer>
+{
+	static inline TResult (APIENTRYP original)(TArguments...) = nullptr;
+	static inline unsigned long long calls = 0;
+
+	static TResult APIENTRY Call(TArguments... arguments)
+	{
+		calls++;
+		return original(arguments...);
+	}
+
+	// Entry points the context lacks stay null, as glad left them
+	static unsigned long long* Install()
+	{
+		original = *pointer;
+		if (original != nullptr) {
+			*pointer = &Call;
+		}
+		return &calls;
+	}
+};
+
+template <auto pointer>
+void GLCallCounter::Count(const char* name)
+{
+	counters.push_back({ name, CountedCall<pointer>::Install() });
+}
+
+void GLCallCounter::Install()
+{
+	if (IsInstalled()) {
+		return;
+	}
+	// Every entry point the engine calls
+	Count<&glad_glAttachShader>("glAttachShader");
+	Count<&glad_glBindBuffer>("glBindBuffer");
+	Count<&glad_glBindBufferBase>("glBindBufferBase");
+	Count<&glad_glBindBufferRange>("glBindBufferRange");
+	Count<&glad_glBindFramebuffer>("glBindFramebuffer");
+	Count<&glad_glBindRenderbuffer>("glBindRenderbuffer");
+	Count<&glad_glBindVertexArray>("glBindVertexArray");
+	Count<&glad_glBindVertexBuffer>("glBindVertexBuffer");
+	Count<&glad_glBlendFunc>("glBlendFunc");
+	Count<&glad_glBufferData>("glBufferData");
+	Count<&glad_glBufferStorage>("glBufferStorage");
+	Count<&glad_glBufferSubData>("glBufferSubData");
+	Count<&glad_glCheckFramebufferStatus>("glCheckFramebufferStatus");
+	Count<&glad_glClear>("glClear");
+	Count<&glad_glClearBufferuiv>("glClearBufferuiv");
+	Count<&glad_glClearColor>("glClearColor");
+	Count<&glad_glClientWaitSync>("glClientWaitSync");
+	Count<&glad_glCompileShader>("glCompileShader");
+	Count<&glad_glCopyBufferSubData>("glCopyBufferSubData");
+	Count<&glad_glCreateProgram>("glCreateProgram");
+	Count<&glad_glCreateShader>("glCreateShader");
+	Count<&glad_glDeleteBuffers>("glDeleteBuffers");
+	Count<&glad_glDeleteFramebuffers>("glDeleteFramebuffers");
+	Count<&glad_glDeleteProgram>("glDeleteProgram");
+	Count<&glad_glDeleteQueries>("glDeleteQueries");
+	Count<&glad_glDeleteRenderbuffers>("glDeleteRenderbuffers");
+	Count<&glad_glDeleteShader>("glDeleteShader");
+	Count<&glad_glDeleteSync>("glDeleteSync");
+	Count<&glad_glDeleteVertexArrays>("glDeleteVertexArrays");
+	Count<&glad_glDepthFunc>("glDepthFunc");
+	Count<&glad_glDetachShader>("glDetachShader");
+	Count<&glad_glDisable>("glDisable");
+	Count<&glad_glDisableVertexAttribArray>("glDisableVertexAttribArray");
+	Count<&glad_glDrawArrays>("glDrawArrays");
+	Count<&glad_glDrawArraysInstancedBaseInstance>("glDrawArraysInstancedBaseInstance");
+	Count<&glad_glDrawElementsBaseVertex>("glDrawElementsBaseVertex");
+	Count<&glad_glDrawElementsInstancedBaseVertexBaseInstance>("glDrawElementsInstancedBaseVertexBaseInstance");
+	Count<&glad_glEnable>("glEnable");
+	Count<&glad_glEnableVertexAttribArray>("glEnableVertexAttribArray");
+	Count<&glad_glFenceSync>("glFenceSync");
+	Count<&glad_glFinish>("glFinish");
+	Count<&glad_glFramebufferRenderbuffer>("glFramebufferRenderbuffer");
+	Count<&glad_glGenBuffers>("glGenBuffers");
+	Count<&glad_glGenFramebuffers>("glGenFramebuffers");
+	Count<&glad_glGenQueries>("glGenQueries");
+	Count<&glad_glGenRenderbuffers>("glGenRenderbuffers");
+	Count<&glad_glGenVertexArrays>("glGenVertexArrays");
+	Count<&glad_glGetAttribLocation>("glGetAttribLocation");
+	Count<&glad_glGetIntegerv>("glGetIntegerv");
+	Count<&glad_glGetProgramInfoLog>("glGetProgramInfoLog");
+	Count<&glad_glGetProgramiv>("glGetProgramiv");
+	Count<&glad_glGetQueryObjectiv>("glGetQueryObjectiv");
+	Count<&glad_glGetQueryObjectui64v>("glGetQueryObjectui64v");
+	Count<&glad_glGetShaderInfoLog>("glGetShaderInfoLog");
+	Count<&glad_glGetShaderiv>("glGetShaderiv");
+	Count<&glad_glGetUniformLocation>("glGetUniformLocation");
+	Count<&glad_glLinkProgram>("glLinkProgram");
+	Count<&glad_glMapBufferRange>("glMapBufferRange");
+	Count<&glad_glMultiDrawArraysIndirect>("glMultiDrawArraysIndirect");
+	Count<&glad_glMultiDrawElementsIndirect>("glMultiDrawElementsIndirect");
+	Count<&glad_glQueryCounter>("glQueryCounter");
+	Count<&glad_glReadPixels>("glReadPixels");
+	Count<&glad_glRenderbufferStorage>("glRenderbufferStorage");
+	Count<&glad_glShaderSource>("glShaderSource");
+	Count<&glad_glUniform1ui>("glUniform1ui");
+	Count<&glad_glUniformMatrix4fv>("glUniformMatrix4fv");
+	Count<&glad_glUnmapBuffer>("glUnmapBuffer");
+	Count<&glad_glUseProgram>("glUseProgram");
+	Count<&glad_glVertexAttribBinding>("glVertexAttribBinding");
+	Count<&glad_glVertexAttribFormat>("glVertexAttribFormat");
+	Count<&glad_glVertexAttribPointer>("glVertexAttribPointer");
+	Count<&glad_glVertexBindingDivisor>("glVertexBindingDivisor");
+	Count<&glad_glViewport>("glViewport");
+}
+
+void GLCallCounter::Reset()
+{
+	for (const Counter& counter : counters) {
+		*counter.calls = 0;
+	}
+}
+
+unsigned long long GLCallCounter::GetTotalCalls()
+{
+	unsigned long long total = 0;
+	for (const Counter& counter : counters) {
+		total += *counter.calls;
+	}
+	return total;
+}
+
+void GLCallCounter::Report(std::ostream& report, int numberOfFrames)
+{
+	std::vector<Counter> called;
+	for (const Counter& counter : counters) {
+		if (*counter.calls > 0) {
+			called.push_back(counter);
+		}
+	}
+	std::stable_sort(called.begin(), called.end(),
+		[](const Counter& a, const Counter& b) { return *a.calls > *b.calls; });
+	for (const Counter& counter : called) {
+		report << "  " << counter.name << " "
+			<< *counter.calls / static_cast<double>(numberOfFrames) << std::endl;
+	}
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <ostream>
+#include <vector>
+
+// Counts every call the engine makes to the GL entry points it uses, not
+// only the binds GLState sees: draws, uniforms, attribute setup, uploads.
+// Install swaps glad's function pointers for ones that count and call
+// through. ImGui loads its own pointers, so its calls are not counted.
+class GLCallCounter
+{
+private:
+	struct Counter {
+		const char* name;
+		unsigned long long* calls;
+	};
+	static std::vector<Counter> counters;
+
+public:
+	// Call once, after glad has loaded the pointers
+	static void Install();
+	inline static bool IsInstalled() { return !counters.empty(); }
+	static void Reset();
+	static unsigned long long GetTotalCalls();
+	// Writes each entry point called since Reset with its calls divided
+	// by numberOfFrames, most called first
+	static void Report(std::ostream& report, int numberOfFrames);
+
+private:
+	// Swaps the glad pointer at pointer for a counting one
+	template <auto pointer>
+	static void Count(const char* name);
+};
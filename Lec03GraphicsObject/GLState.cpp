@@ -0,0 +1,257 @@
+#include "GLState.h"
+
+unsigned int GLState::program = GLState::unknown;
+unsigned int GLState::vertexArray = GLState::unknown;
+unsigned int GLState::framebuffer = GLState::unknown;
+unsigned int GLState::buffers[GLState::numberOfBufferTargets] = {
+	GLState::unknown, GLState::unknown, GLState::unknown, GLState::unknown,
+	GLState::unknown, GLState::unknown, GLState::unknown, GLState::unknown
+};
+// Size 0 never matches a bind, so every binding starts out unknown
+GLState::BufferRange GLState::uniformBindings[GLState::numberOfUniformBindings] = {};
+std::unordered_map<unsigned int, unsigned int> GLState::enabledAttributes;
+int GLState::blend = -1;
+int GLState::depthTest = -1;
+int GLState::cullFace = -1;
+GLenum GLState::blendSource = GLState::unknown;
+GLenum GLState::blendDestination = GLState::unknown;
+GLenum GLState::depthFunction = GLState::unknown;
+
+unsigned long long GLState::issuedCalls = 0;
+unsigned long long GLState::redundantCalls = 0;
+
+bool GLState::UseProgram(unsigned int program)
+{
+	if (IsRedundant(GLState::program == program)) {
+		return false;
+	}
+	GLState::program = program;
+	glUseProgram(program);
+	return true;
+}
+
+void GLState::BindVertexArray(unsigned int vertexArray)
+{
+	if (IsRedundant(GLState::vertexArray == vertexArray)) {
+		return;
+	}
+	GLState::vertexArray = vertexArray;
+	glBindVertexArray(vertexArray);
+	// The element buffer binding belongs to the VAO
+	buffers[GetBufferTargetIndex(GL_ELEMENT_ARRAY_BUFFER)] = unknown;
+}
+
+void GLState::BindBuffer(GLenum target, unsigned int buffer)
+{
+	int index = GetBufferTargetIndex(target);
+	if (index >= 0) {
+		if (IsRedundant(buffers[index] == buffer)) {
+			return;
+		}
+		buffers[index] = buffer;
+	}
+	glBindBuffer(target, buffer);
+}
+
+void GLState::BindFramebuffer(unsigned int framebuffer)
+{
+	if (IsRedundant(GLState::framebuffer == framebuffer)) {
+		return;
+	}
+	GLState::framebuffer = framebuffer;
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+}
+
+void GLState::BindBufferBase(GLenum target, unsigned int index, unsigned int buffer)
+{
+	// The whole buffer is recorded as a range of size -1
+	if (target == GL_UNIFORM_BUFFER && index < numberOfUniformBindings) {
+		BufferRange& bound = uniformBindings[index];
+		if (IsRedundant(bound.buffer == buffer && bound.size == -1)) {
+			return;
+		}
+		bound = { buffer, 0, -1 };
+	}
+	// Indexed binds also set the generic binding of the target
+	int targetIndex = GetBufferTargetIndex(target);
+	if (targetIndex >= 0) {
+		buffers[targetIndex] = buffer;
+	}
+	glBindBufferBase(target, index, buffer);
+}
+
+void GLState::BindBufferRange(
+	GLenum target, unsigned int index, unsigned int buffer,
+	GLintptr offset, GLsizeiptr size)
+{
+	if (target == GL_UNIFORM_BUFFER && index < numberOfUniformBindings) {
+		BufferRange& bound = uniformBindings[index];
+		if (IsRedundant(
+			bound.buffer == buffer && bound.offset == offset && bound.size == size)) {
+			return;
+		}
+		bound = { buffer, offset, size };
+	}
+	int targetIndex = GetBufferTargetIndex(target);
+	if (targetIndex >= 0) {
+		buffers[targetIndex] = buffer;
+	}
+	glBindBufferRange(target, index, buffer, offset, size);
+}
+
+void GLState::EnableVertexAttribArray(unsigned int index)
+{
+	if (vertexArray != unknown && index < 32) {
+		unsigned int& enabled = enabledAttributes[vertexArray];
+		if (IsRedundant((enabled & (1u << index)) != 0)) {
+			return;
+		}
+		enabled |= 1u << index;
+	}
+	glEnableVertexAttribArray(index);
+}
+
+void GLState::Enable(GLenum capability)
+{
+	SetCapability(capability, true);
+}
+
+void GLState::Disable(GLenum capability)
+{
+	SetCapability(capability, false);
+}
+
+void GLState::BlendFunc(GLenum source, GLenum destination)
+{
+	if (IsRedundant(blendSource == source && blendDestination == destination)) {
+		return;
+	}
+	blendSource = source;
+	blendDestination = destination;
+	glBlendFunc(source, destination);
+}
+
+void GLState::DepthFunc(GLenum function)
+{
+	if (IsRedundant(depthFunction == function)) {
+		return;
+	}
+	depthFunction = function;
+	glDepthFunc(function);
+}
+
+void GLState::DeleteBuffers(GLsizei count, const unsigned int* ids)
+{
+	for (GLsizei i = 0; i < count; i++) {
+		for (auto& buffer : buffers) {
+			if (buffer == ids[i]) {
+				buffer = 0;
+			}
+		}
+		for (auto& binding : uniformBindings) {
+			if (binding.buffer == ids[i]) {
+				binding = { 0, 0, 0 };
+			}
+		}
+	}
+	glDeleteBuffers(count, ids);
+}
+
+void GLState::DeleteVertexArrays(GLsizei count, const unsigned int* ids)
+{
+	for (GLsizei i = 0; i < count; i++) {
+		if (vertexArray == ids[i]) {
+			vertexArray = 0;
+			buffers[GetBufferTargetIndex(GL_ELEMENT_ARRAY_BUFFER)] = unknown;
+		}
+		// A later VAO can reuse the name with every attribute disabled
+		enabledAttributes.erase(ids[i]);
+	}
+	glDeleteVertexArrays(count, ids);
+}
+
+void GLState::DeleteProgram(unsigned int program)
+{
+	// A deleted program stays in use until another is selected
+	if (GLState::program == program) {
+		GLState::program = unknown;
+	}
+	glDeleteProgram(program);
+}
+
+void GLState::DeleteFramebuffer(unsigned int framebuffer)
+{
+	// Deleting the bound framebuffer reverts to the default one
+	if (GLState::framebuffer == framebuffer) {
+		GLState::framebuffer = 0;
+	}
+	glDeleteFramebuffers(1, &framebuffer);
+}
+
+void GLState::Invalidate()
+{
+	program = unknown;
+	vertexArray = unknown;
+	framebuffer = unknown;
+	for (auto& buffer : buffers) {
+		buffer = unknown;
+	}
+	for (auto& binding : uniformBindings) {
+		binding = { 0, 0, 0 };
+	}
+	enabledAttributes.clear();
+	blend = -1;
+	depthTest = -1;
+	cullFace = -1;
+	blendSource = unknown;
+	blendDestination = unknown;
+	depthFunction = unknown;
+}
+
+int GLState::GetBufferTargetIndex(GLenum target)
+{
+	switch (target) {
+	case GL_ARRAY_BUFFER: return 0;
+	case GL_ELEMENT_ARRAY_BUFFER: return 1;
+	case GL_UNIFORM_BUFFER: return 2;
+	case GL_COPY_READ_BUFFER: return 3;
+	case GL_COPY_WRITE_BUFFER: return 4;
+	case GL_DRAW_INDIRECT_BUFFER: return 5;
+	case GL_SHADER_STORAGE_BUFFER: return 6;
+	case GL_PIXEL_PACK_BUFFER: return 7;
+	}
+	return -1;
+}
+
+bool GLState::IsRedundant(bool isSame)
+{
+	if (isSame) {
+		redundantCalls++;
+	}
+	else {
+		issuedCalls++;
+	}
+	return isSame;
+}
+
+void GLState::SetCapability(GLenum capability, bool enable)
+{
+	int* cached = nullptr;
+	switch (capability) {
+	case GL_BLEND: cached = &blend; break;
+	case GL_DEPTH_TEST: cached = &depthTest; break;
+	case GL_CULL_FACE: cached = &cullFace; break;
+	}
+	if (cached != nullptr) {
+		if (IsRedundant(*cached == (enable ? 1 : 0))) {
+			return;
+		}
+		*cached = enable ? 1 : 0;
+	}
+	if (enable) {
+		glEnable(capability);
+	}
+	else {
+		glDisable(capability);
+	}
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <glad/glad.h>
+#include <unordered_map>
+
+// Tracks the GL bindings and capabilities the engine sets and skips any
+// call that would leave them unchanged. Engine classes make these calls
+// through GLState instead of calling GL directly, so the cache stays
+// true; code that goes around it (e.g. ImGui) should be followed by
+// Invalidate.
+class GLState
+{
+private:
+	// A binding the cache knows nothing about, so the next call is issued
+	static constexpr unsigned int unknown = 0xFFFFFFFF;
+	static constexpr int numberOfBufferTargets = 8;
+	static constexpr unsigned int numberOfUniformBindings = 16;
+
+	struct BufferRange {
+		unsigned int buffer;
+		GLintptr offset;
+		GLsizeiptr size;
+	};
+
+	static unsigned int program;
+	static unsigned int vertexArray;
+	static unsigned int framebuffer;
+	static unsigned int buffers[numberOfBufferTargets];
+	static BufferRange uniformBindings[numberOfUniformBindings];
+	// Bit i is set when attribute i is enabled, per VAO
+	static std::unordered_map<unsigned int, unsigned int> enabledAttributes;
+	// 1 enabled, 0 disabled, -1 unknown
+	static int blend, depthTest, cullFace;
+	static GLenum blendSource, blendDestination, depthFunction;
+
+	// Cheap enough to keep in release builds, where headless runs measure
+	static unsigned long long issuedCalls;
+	static unsigned long long redundantCalls;
+
+public:
+	// Returns true if glUseProgram was issued
+	static bool UseProgram(unsigned int program);
+	static void BindVertexArray(unsigned int vertexArray);
+	static void BindBuffer(GLenum target, unsigned int buffer);
+	// Binds for both drawing and reading
+	static void BindFramebuffer(unsigned int framebuffer);
+	static void BindBufferBase(GLenum target, unsigned int index, unsigned int buffer);
+	static void BindBufferRange(
+		GLenum target, unsigned int index, unsigned int buffer,
+		GLintptr offset, GLsizeiptr size);
+	// Applies to the bound VAO
+	static void EnableVertexAttribArray(unsigned int index);
+	static void Enable(GLenum capability);
+	static void Disable(GLenum capability);
+	static void BlendFunc(GLenum source, GLenum destination);
+	static void DepthFunc(GLenum function);
+
+	// GL drops bindings to deleted objects, so deletes go through here too
+	static void DeleteBuffers(GLsizei count, const unsigned int* ids);
+	static void DeleteVertexArrays(GLsizei count, const unsigned int* ids);
+	static void DeleteProgram(unsigned int program);
+	static void DeleteFramebuffer(unsigned int framebuffer);
+
+	// Forgets everything, so the next call of each kind is issued
+	static void Invalidate();
+
+	inline static unsigned long long GetIssuedCalls() { return issuedCalls; }
+	inline static unsigned long long GetRedundantCalls() { return redundantCalls; }
+	inline static void ResetCallCounts() { issuedCalls = 0; redundantCalls = 0; }
+
+private:
+	// Index into buffers, -1 for targets the cache does not track
+	static int GetBufferTargetIndex(GLenum target);
+	// Counts the call and returns isSame, i.e. whether to skip it
+	static bool IsRedundant(bool isSame);
+	static void SetCapability(GLenum capability, bool enable);
+};
@@ -0,0 +1,203 @@
+#include "GpuPicker.h"
+#include <algorithm>
+#include <cstring>
+#include <glm/gtc/matrix_transform.hpp>
+#include "GLState.h"
+#include "RenderQueue.h"
+
+GpuPicker::GpuPicker() : idTarget(1, 1, GL_RG32UI)
+{
+	const std::string vertexSource =
+		"#version 430\n"
+		"layout(location = 0) in vec3 position;\n"
+		"uniform mat4 transform;\n"
+		"void main()\n"
+		"{\n"
+		"   gl_Position = transform * vec4(position, 1.0);\n"
+		"}\n";
+	const std::string fragmentSource =
+		"#version 430\n"
+		"uniform uint objectId;\n"
+		"layout(location = 0) out uvec2 id;\n"
+		"void main()\n"
+		"{\n"
+		"   id = uvec2(objectId, uint(gl_PrimitiveID));\n"
+		"}\n";
+	idShader = std::make_shared<Shader>(vertexSource, fragmentSource);
+	idShader->AddUniform("transform");
+	idShader->AddUniform("objectId");
+
+	glGenBuffers(1, &pboId);
+	GLState::BindBuffer(GL_PIXEL_PACK_BUFFER, pboId);
+	glBufferData(GL_PIXEL_PACK_BUFFER, 2 * sizeof(GLuint), nullptr, GL_STREAM_READ);
+	GLState::BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	fence = nullptr;
+}
+
+GpuPicker::~GpuPicker()
+{
+	DeleteFence();
+	GLState::DeleteBuffers(1, &pboId);
+}
+
+void GpuPicker::Request(
+	Scene& scene, const glm::mat4& view, const glm::mat4& projection,
+	double cursorX, double cursorY, int width, int height)
+{
+	DeleteFence();
+	targets.clear();
+	if (!idShader->IsCreated()) {
+		return;
+	}
+
+	// Narrow the view volume to the cursor's pixel, which then fills the
+	// one pixel target; only what the narrow volume finds is drawn
+	glm::mat4 pick = glm::pickMatrix(
+		glm::vec2(static_cast<float>(cursorX), height - static_cast<float>(cursorY)),
+		glm::vec2(1.0f), glm::vec4(0.0f, 0.0f, width, height));
+	glm::mat4 pickViewProjection = pick * projection * view;
+	Frustum frustum(pickViewProjection);
+	SceneQueryResult candidates;
+	scene.Query(frustum, candidates);
+
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	idTarget.Select();
+	glViewport(0, 0, 1, 1);
+	const GLuint background[4] = { 0, 0, 0, 0 };
+	glClearBufferuiv(GL_COLOR, 0, background);
+	glClear(GL_DEPTH_BUFFER_BIT);
+	// Equal depths go to the later draw, as on screen
+	GLState::Enable(GL_DEPTH_TEST);
+	GLState::DepthFunc(GL_LEQUAL);
+	GLState::UseProgram(idShader->GetShaderProgram());
+
+	// Collected in the renderer's submission order, then sorted by its
+	// queue key: equal depths go to the same draw here as on screen
+	draws.clear();
+	for (GraphicsObject* object : candidates.objects) {
+		AddObjectDraws(*object, view, frustum);
+	}
+	EntityRegistry& registry = scene.GetRegistry();
+	for (Entity entity : candidates.entities) {
+		// AddMesh gave every indexed entity all of these
+		if (registry.GetVisibilities().Get(entity).isHidden) {
+			continue;
+		}
+		VertexBuffer* buffer = registry.GetMeshes().Get(entity).buffer;
+		const glm::mat4& world = registry.GetTransforms().Get(entity).world;
+		// The renderer uses one program, so that field never orders
+		std::uint64_t key = RenderQueue::MakeKey(
+			registry.GetMaterials().Get(entity).pass, 0, buffer->GetVertexArrayId(),
+			buffer->GetPrimitiveType(), -(view * world[3]).z);
+		draws.push_back({ key, buffer, world, { nullptr, entity, buffer->GetPrimitiveType() } });
+	}
+	// Stable, as the renderer's radix sort
+	std::stable_sort(draws.begin(), draws.end(),
+		[](const Draw& a, const Draw& b) { return a.key < b.key; });
+
+	for (const Draw& draw : draws) {
+		targets.push_back(draw.target);
+		DrawTarget(*draw.buffer, draw.world, pickViewProjection,
+			static_cast<unsigned int>(targets.size()));
+	}
+
+	// Into the pixel buffer, so the call returns without waiting
+	GLState::BindBuffer(GL_PIXEL_PACK_BUFFER, pboId);
+	glReadPixels(0, 0, 1, 1, GL_RG_INTEGER, GL_UNSIGNED_INT, nullptr);
+	GLState::BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	// As the renderer leaves it
+	GLState::Disable(GL_DEPTH_TEST);
+	GLState::UseProgram(0);
+	GLState::BindVertexArray(0);
+	idTarget.Deselect();
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
+
+bool GpuPicker::Poll(const Scene& scene, PickResult& result)
+{
+	if (fence == nullptr) {
+		return false;
+	}
+	// A zero timeout only asks, the flush makes sure the copy was sent
+	GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+	if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+		return false;
+	}
+	DeleteFence();
+
+	GLuint ids[2] = { 0, 0 };
+	GLState::BindBuffer(GL_PIXEL_PACK_BUFFER, pboId);
+	void* data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, sizeof(ids), GL_MAP_READ_BIT);
+	if (data != nullptr) {
+		std::memcpy(ids, data, sizeof(ids));
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	}
+	GLState::BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	result = { nullptr, Entity(), PickResult::noPrimitive, 0.0f, glm::vec3(0.0f) };
+	if (ids[0] == 0 || ids[0] > targets.size()) {
+		return true;
+	}
+	const Target& target = targets[ids[0] - 1];
+	// The entity may have been destroyed while the copy was on its way
+	if (target.object == nullptr && !scene.GetRegistry().IsAlive(target.entity)) {
+		return true;
+	}
+	result.object = target.object;
+	result.entity = target.entity;
+	if (target.primitiveType == GL_TRIANGLES) {
+		result.primitive = ids[1];
+	}
+	return true;
+}
+
+void GpuPicker::AddObjectDraws(
+	GraphicsObject& object, const glm::mat4& view, const Frustum& frustum)
+{
+	if (!frustum.Intersects(object.GetSubtreeBox())) {
+		return;
+	}
+	VertexBuffer* buffer = object.GetVertexBuffer().get();
+	if (buffer != nullptr && frustum.Intersects(object.GetWorldBox())) {
+		const glm::mat4& world = object.GetReferenceFrame();
+		std::uint64_t key = RenderQueue::MakeKey(
+			0, 0, buffer->GetVertexArrayId(), buffer->GetPrimitiveType(),
+			-(view * world[3]).z);
+		draws.push_back({ key, buffer, world, { &object, Entity(), buffer->GetPrimitiveType() } });
+	}
+	for (const auto& child : object.GetChildren()) {
+		AddObjectDraws(*child, view, frustum);
+	}
+}
+
+void GpuPicker::DrawTarget(
+	VertexBuffer& buffer, const glm::mat4& world,
+	const glm::mat4& pickViewProjection, unsigned int id)
+{
+	idShader->SendMat4Uniform("transform", pickViewProjection * world);
+	idShader->SendUIntUniform("objectId", id);
+	// The attribute setup was recorded into the VAO at allocation time
+	buffer.SelectVertexArray();
+	if (buffer.IsIndexed()) {
+		auto& indexBuffer = buffer.GetIndexBuffer();
+		glDrawElementsBaseVertex(
+			buffer.GetPrimitiveType(), indexBuffer->GetNumberOfIndices(),
+			indexBuffer->GetIndexType(), nullptr, buffer.GetFirstVertex());
+	}
+	else {
+		glDrawArrays(
+			buffer.GetPrimitiveType(), buffer.GetFirstVertex(),
+			buffer.GetNumberOfVertices());
+	}
+}
+
+void GpuPicker::DeleteFence()
+{
+	if (fence != nullptr) {
+		glDeleteSync(fence);
+		fence = nullptr;
+	}
+}
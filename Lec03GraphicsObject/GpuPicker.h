@@ -0,0 +1,69 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "Framebuffer.h"
+#include "Picking.h"
+#include "Scene.h"
+#include "Shader.h"
+
+// Finds what is under the cursor on the GPU, for meshes whose vertices
+// were released or when the exact drawn pixel matters. The candidates
+// near the cursor are drawn into a one pixel ID target, whose pixel is
+// copied to a pixel buffer; the result is read frames later, once a
+// fence says the copy is done, so the CPU never waits on the GPU.
+class GpuPicker
+{
+private:
+	// What an ID stands for; ID 0 is the cleared background
+	struct Target {
+		GraphicsObject* object;
+		Entity entity;
+		int primitiveType;
+	};
+
+	// A candidate with the renderer's queue key for it
+	struct Draw {
+		std::uint64_t key;
+		VertexBuffer* buffer;
+		glm::mat4 world;
+		Target target;
+	};
+
+	// Object ID and gl_PrimitiveID per pixel
+	Framebuffer idTarget;
+	std::shared_ptr<Shader> idShader;
+	unsigned int pboId;
+	GLsync fence;
+	std::vector<Target> targets;
+	std::vector<Draw> draws;
+
+public:
+	GpuPicker();
+	~GpuPicker();
+
+	inline bool IsPending() const { return fence != nullptr; }
+
+	// Draws what is under the cursor, in window coordinates (y down), and
+	// starts copying it back; replaces a request still pending. Run after
+	// the scene was rendered, so its indices are up to date.
+	void Request(
+		Scene& scene, const glm::mat4& view, const glm::mat4& projection,
+		double cursorX, double cursorY, int width, int height);
+	// Returns false while the copy is still on its way. The result has no
+	// distance or point, and primitive is PickResult::noPrimitive for
+	// meshes without triangles.
+	bool Poll(const Scene& scene, PickResult& result);
+
+private:
+	// Adds the object and its children as the renderer queues them,
+	// parents first
+	void AddObjectDraws(
+		GraphicsObject& object, const glm::mat4& view, const Frustum& frustum);
+	void DrawTarget(
+		VertexBuffer& buffer, const glm::mat4& world,
+		const glm::mat4& pickViewProjection, unsigned int id);
+	void DeleteFence();
+};
@@ -1,20 +1,31 @@
 #include "GraphicsObject.h"
 #include <glm/gtc/matrix_transform.hpp>
+#include "FrameInvalidation.h"
 
-GraphicsObject::GraphicsObject() : referenceFrame(1.0f), parent(nullptr)
+GraphicsObject::GraphicsObject() : 
+	referenceFrame(1.0f), parent(nullptr), worldFrame(1.0f)
 {
+	isWorldFrameDirty = true;
+	areWorldBoundsDirty = true;
+	boundsVersion = 0;
 }
 
 GraphicsObject::~GraphicsObject()
 {
 }
 
-const glm::mat4 GraphicsObject::GetReferenceFrame() const
+const glm::mat4& GraphicsObject::GetReferenceFrame() const
 {
-	if (parent != nullptr) {
-		return parent->referenceFrame * referenceFrame;
+	if (isWorldFrameDirty) {
+		if (parent != nullptr) {
+			worldFrame = parent->GetReferenceFrame() * referenceFrame;
+		}
+		else {
+			worldFrame = referenceFrame;
+		}
+		isWorldFrameDirty = false;
 	}
-	return referenceFrame;
+	return worldFrame;
 }
 
 void GraphicsObject::CreateVertexBuffer(unsigned int numberOfElementsPerVertex)
@@ -25,27 +36,80 @@ void GraphicsObject::CreateVertexBuffer(unsigned int numberOfElementsPerVertex)
 void GraphicsObject::SetVertexBuffer(std::shared_ptr<VertexBuffer> buffer)
 {
 	this->buffer = buffer;
+	areWorldBoundsDirty = true;
+	FrameInvalidation::Invalidate();
 }
 
 void GraphicsObject::StaticAllocateVertexBuffer()
 {
-	buffer->Select();
-	buffer->StaticAllocate();
-	buffer->Deselect();
+	// A node without a buffer only groups its children
+	if (buffer != nullptr) {
+		buffer->Select();
+		buffer->StaticAllocate();
+		buffer->Deselect();
+	}
 	for (auto& child : children) {
 		child->StaticAllocateVertexBuffer();
 	}
 }
 
+void GraphicsObject::UploadDirtyVertexBuffer()
+{
+	if (buffer != nullptr) {
+		if (buffer->IsDirty()) {
+			buffer->Select();
+			buffer->UploadDirtyRanges();
+			buffer->Deselect();
+		}
+		// Recording threads then read the bounds without computing them
+		buffer->RefreshBounds();
+	}
+	for (auto& child : children) {
+		child->UploadDirtyVertexBuffer();
+	}
+}
+
+bool GraphicsObject::UpdateWorldBounds()
+{
+	bool isChanged = false;
+	// Without a buffer the node's own bounds stay empty, but its
+	// children still make up its subtree box
+	unsigned long long version = buffer != nullptr ? buffer->GetBoundsVersion() : 0;
+	if (areWorldBoundsDirty || version != boundsVersion) {
+		const glm::mat4& world = GetReferenceFrame();
+		worldBox = buffer != nullptr ?
+			buffer->GetBoundingBox().Transform(world) : BoundingBox();
+		worldSphere = buffer != nullptr ?
+			buffer->GetBoundingSphere().Transform(world) : BoundingSphere();
+		boundsVersion = version;
+		areWorldBoundsDirty = false;
+		isChanged = true;
+	}
+	for (auto& child : children) {
+		isChanged |= child->UpdateWorldBounds();
+	}
+	if (isChanged) {
+		subtreeBox = worldBox;
+		for (auto& child : children) {
+			subtreeBox.Include(child->subtreeBox);
+		}
+	}
+	return isChanged;
+}
+
 void GraphicsObject::AddChild(std::shared_ptr<GraphicsObject> child)
 {
 	children.push_back(child);
 	child->parent = this;
+	child->MarkWorldFrameDirty();
+	FrameInvalidation::Invalidate();
 }
 
 void GraphicsObject::SetPosition(const glm::vec3& position)
 {
 	referenceFrame[3] = glm::vec4(position, 1.0f);
+	MarkWorldFrameDirty();
+	FrameInvalidation::Invalidate();
 }
 
 void GraphicsObject::ResetOrientation()
@@ -53,6 +117,8 @@ void GraphicsObject::ResetOrientation()
 	glm::vec4 position = referenceFrame[3];
 	referenceFrame = glm::mat4(1.0f);
 	referenceFrame[3] = position;
+	MarkWorldFrameDirty();
+	FrameInvalidation::Invalidate();
 }
 
 void GraphicsObject::RotateLocalZ(float degrees)
@@ -62,4 +128,19 @@ void GraphicsObject::RotateLocalZ(float degrees)
 		glm::radians(degrees), 
 		glm::vec3(0.0f, 0.0f, 1.0f)
 	);
+	MarkWorldFrameDirty();
+	FrameInvalidation::Invalidate();
+}
+
+void GraphicsObject::MarkWorldFrameDirty()
+{
+	// A dirty object's subtree is already dirty, so the walk stops there
+	if (isWorldFrameDirty) {
+		return;
+	}
+	isWorldFrameDirty = true;
+	areWorldBoundsDirty = true;
+	for (auto& child : children) {
+		child->MarkWorldFrameDirty();
+	}
 }
@@ -11,18 +11,41 @@ protected:
 	std::shared_ptr<VertexBuffer> buffer;
 	GraphicsObject* parent;
 	std::vector<std::shared_ptr<GraphicsObject>> children;
+	// The reference frame times every ancestor's, recomputed only after
+	// this object or an ancestor moved. A dirty object's whole subtree is
+	// dirty.
+	mutable glm::mat4 worldFrame;
+	mutable bool isWorldFrameDirty;
+	// World bounds of this object's vertices, and of it with its subtree
+	BoundingBox worldBox;
+	BoundingSphere worldSphere;
+	BoundingBox subtreeBox;
+	bool areWorldBoundsDirty;
+	// The buffer's bounds version the world bounds were computed from
+	unsigned long long boundsVersion;
 
 public:
 	GraphicsObject();
 	virtual ~GraphicsObject();
 
-	const glm::mat4 GetReferenceFrame() const;
+	// The world matrix, through every ancestor
+	const glm::mat4& GetReferenceFrame() const;
 	void CreateVertexBuffer(unsigned int numberOfElementsPerVertex);
 	void SetVertexBuffer(std::shared_ptr<VertexBuffer> buffer);
 	inline const std::shared_ptr<VertexBuffer>& GetVertexBuffer() const {
 		return buffer;
 	}
 	void StaticAllocateVertexBuffer();
+	// Sends pending vertex edits of this object and its children, and
+	// brings their bounds up to date
+	void UploadDirtyVertexBuffer();
+
+	// Recomputes the world bounds of the objects in this subtree that moved
+	// or whose vertices changed; returns true if the subtree box changed
+	bool UpdateWorldBounds();
+	inline const BoundingBox& GetWorldBox() const { return worldBox; }
+	inline const BoundingSphere& GetWorldSphere() const { return worldSphere; }
+	inline const BoundingBox& GetSubtreeBox() const { return subtreeBox; }
 
 	void AddChild(std::shared_ptr<GraphicsObject> child);
 	inline const std::vector<std::shared_ptr<GraphicsObject>>& GetChildren() const {
@@ -32,5 +55,9 @@ public:
 	void SetPosition(const glm::vec3& position);
 	void ResetOrientation();
 	void RotateLocalZ(float degrees);
+
+protected:
+	// Marks this object and its subtree as needing a new world frame
+	void MarkWorldFrameDirty();
 };
 
@@ -0,0 +1,71 @@
+#include "IndexBuffer.h"
+#include <algorithm>
+
+IndexBuffer::IndexBuffer()
+{
+	indexType = GL_UNSIGNED_INT;
+	maxIndex = 0;
+	glGenBuffers(1, &iboId);
+}
+
+IndexBuffer::~IndexBuffer()
+{
+	GLState::DeleteBuffers(1, &iboId);
+}
+
+void IndexBuffer::AddIndex(unsigned int index)
+{
+	indexData.push_back(index);
+	maxIndex = std::max(maxIndex, index);
+}
+
+void IndexBuffer::AddIndices(std::span<const unsigned int> indices)
+{
+	indexData.insert(indexData.end(), indices.begin(), indices.end());
+	for (unsigned int index : indices) {
+		maxIndex = std::max(maxIndex, index);
+	}
+}
+
+void IndexBuffer::SetIndices(std::vector<unsigned int> indices)
+{
+	indexData = std::move(indices);
+	maxIndex = 0;
+	for (unsigned int index : indexData) {
+		maxIndex = std::max(maxIndex, index);
+	}
+}
+
+void IndexBuffer::RemapIndices(std::span<const unsigned int> remap)
+{
+	maxIndex = 0;
+	for (unsigned int& index : indexData) {
+		if (index >= remap.size()) {
+			throw "Index out of range of the remap table!";
+		}
+		index = remap[index];
+		maxIndex = std::max(maxIndex, index);
+	}
+}
+
+void IndexBuffer::StaticAllocate()
+{
+	if (maxIndex <= 0xFFFF) {
+		// Half the memory and bandwidth when every index fits in 16 bits
+		std::vector<unsigned short> shortIndices(indexData.begin(), indexData.end());
+		indexType = GL_UNSIGNED_SHORT;
+		glBufferData(
+			GL_ELEMENT_ARRAY_BUFFER, shortIndices.size() * sizeof(unsigned short),
+			shortIndices.data(), GL_STATIC_DRAW);
+		return;
+	}
+	indexType = GL_UNSIGNED_INT;
+	glBufferData(
+		GL_ELEMENT_ARRAY_BUFFER, indexData.size() * sizeof(unsigned int),
+		indexData.data(), GL_STATIC_DRAW);
+}
+
+void IndexBuffer::RecreateAfterContextLoss()
+{
+	glGenBuffers(1, &iboId);
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <glad/glad.h> 
+#include <vector>
+#include <span>
+#include "GLState.h"
+
+class IndexBuffer
+{
+protected:
+	unsigned int iboId;
+	// The smallest index type that holds every index, set by StaticAllocate
+	int indexType;
+	unsigned int maxIndex;
+	std::vector<unsigned int> indexData;
+
+public:
+	IndexBuffer();
+	~IndexBuffer();
+
+	inline void Select() { GLState::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, iboId); }
+	inline void Deselect() { GLState::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0); }
+	inline unsigned int GetNumberOfIndices() const { 
+		return static_cast<unsigned int>(indexData.size()); 
+	}
+	inline int GetIndexType() const { return indexType; }
+	inline const std::vector<unsigned int>& GetIndices() const { return indexData; }
+
+	void AddIndex(unsigned int index);
+	void AddIndices(std::span<const unsigned int> indices);
+	void SetIndices(std::vector<unsigned int> indices);
+	// Replaces every index i with remap[i]
+	void RemapIndices(std::span<const unsigned int> remap);
+	void StaticAllocate();
+	// Creates a new GL buffer; the indices are sent again when the owning
+	// vertex buffer records its VAO
+	void RecreateAfterContextLoss();
+};
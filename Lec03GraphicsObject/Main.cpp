@@ -9,19 +9,63 @@
 #include <vector>
 #include <sstream>
 #include <string>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <glm/gtc/constants.hpp>
 #include "VertexBuffer.h"
+#include "VertexArena.h"
 #include "GraphicsObject.h"
 #include "Scene.h"
 #include "Shader.h"
-#include "Renderer.cpp"
+#include "Renderer.h"
 #include "TextFile.h"
+#include "GLState.h"
+#include "GLCallCounter.h"
+#include "FrameProfiler.h"
+#include "Framebuffer.h"
+#include "FrameInvalidation.h"
+#include "Picking.h"
+#include "GpuPicker.h"
+#include "Benchmarks.h"
+
+// Frames drawn after input, enough for ImGui to show its response
+static const int framesAfterInput = 3;
 
 void OnWindowSizeChanged(GLFWwindow* window, int width, int height)
 {
 	glViewport(0, 0, width, height);
+	FrameInvalidation::Invalidate();
+}
+
+// Installed before ImGui's callbacks, which call these in turn
+static void OnCursorMoved(GLFWwindow* window, double x, double y)
+{
+	FrameInvalidation::Invalidate(framesAfterInput);
+}
+
+static void OnMouseButton(GLFWwindow* window, int button, int action, int mods)
+{
+	FrameInvalidation::Invalidate(framesAfterInput);
+}
+
+static void OnScroll(GLFWwindow* window, double x, double y)
+{
+	FrameInvalidation::Invalidate(framesAfterInput);
+}
+
+static void OnKey(GLFWwindow* window, int key, int scancode, int action, int mods)
+{
+	FrameInvalidation::Invalidate(framesAfterInput);
+}
+
+static void OnWindowRefresh(GLFWwindow* window)
+{
+	FrameInvalidation::Invalidate();
 }
 
 void ProcessInput(GLFWwindow* window)
@@ -31,6 +75,24 @@ void ProcessInput(GLFWwindow* window)
 	}
 }
 
+static void ShowProfilerPanel(const FrameProfiler& profiler)
+{
+	const std::vector<float>& frames = profiler.GetFrameMilliseconds();
+	TimingSummary frame = FrameProfiler::Summarize(frames);
+	ImGui::PlotLines("Frame ms", frames.data(), static_cast<int>(frames.size()),
+		static_cast<int>(profiler.GetHistoryOffset()), nullptr, 0.0f, 
+		frame.p99 * 1.5f, ImVec2(0, 60));
+	ImGui::Text("Frame p50 %.2f, p99 %.2f, max %.2f ms", 
+		frame.p50, frame.p99, frame.max);
+	for (const auto& zone : profiler.GetZones()) {
+		TimingSummary cpu = FrameProfiler::Summarize(zone.cpuMilliseconds);
+		TimingSummary gpu = FrameProfiler::Summarize(zone.gpuMilliseconds);
+		ImGui::Text("%-8s CPU %.2f/%.2f/%.2f  GPU %.2f/%.2f/%.2f ms",
+			zone.name.c_str(), cpu.p50, cpu.p99, cpu.max, 
+			gpu.p50, gpu.p99, gpu.max);
+	}
+}
+
 static glm::mat4 CreateViewMatrix(const glm::vec3& position, const glm::vec3& direction, const glm::vec3& up)
 {
 	glm::vec3 right = glm::cross(direction, up);
@@ -47,15 +109,234 @@ static glm::mat4 CreateViewMatrix(const glm::vec3& position, const glm::vec3& di
 	return glm::inverse(view);
 }
 
+// Adds a grid of small squares as entities, one shared mesh for all, for
+// measuring the entity path with far more draws than the demo has
+static void AddEntityGrid(Scene& scene, int columns)
+{
+	std::shared_ptr<VertexBuffer> buffer = std::make_shared<VertexBuffer>(3);
+	VertexData squareVertices[] = {
+		{ {-0.4f, 0.4f, 0.0f}, {1.0f, 1.0f, 0.0f} },
+		{ {-0.4f,-0.4f, 0.0f}, {1.0f, 1.0f, 0.0f} },
+		{ { 0.4f,-0.4f, 0.0f}, {1.0f, 1.0f, 0.0f} },
+		{ {-0.4f, 0.4f, 0.0f}, {0.0f, 1.0f, 1.0f} },
+		{ { 0.4f,-0.4f, 0.0f}, {0.0f, 1.0f, 1.0f} },
+		{ { 0.4f, 0.4f, 0.0f}, {0.0f, 1.0f, 1.0f} }
+	};
+	buffer->AddVertices<PackedColorVertex>(squareVertices, PackColorVertex);
+	buffer->SetLayout<PackedColorVertexLayout>();
+	VertexBuffer* mesh = scene.AddMesh(buffer);
+
+	// Centered on the origin, so the view sees part of it and culls the rest
+	EntityRegistry& registry = scene.GetRegistry();
+	for (int row = 0; row < columns; row++) {
+		for (int column = 0; column < columns; column++) {
+			glm::vec3 position(
+				static_cast<float>(column - columns / 2),
+				static_cast<float>(row - columns / 2), 0.0f);
+			registry.CreateDrawable(mesh, glm::translate(glm::mat4(1.0f), position));
+		}
+	}
+}
+
+// Adds a grid of root objects, each a square with a smaller child, all
+// sharing two buffers; enough roots for the renderer to use its workers
+static void AddObjectGrid(Scene& scene, int columns)
+{
+	std::shared_ptr<VertexBuffer> square = std::make_shared<VertexBuffer>(3);
+	VertexData squareVertices[] = {
+		{ {-0.4f, 0.4f, 0.0f}, {1.0f, 0.0f, 1.0f} },
+		{ {-0.4f,-0.4f, 0.0f}, {1.0f, 0.0f, 1.0f} },
+		{ { 0.4f,-0.4f, 0.0f}, {1.0f, 0.0f, 1.0f} },
+		{ {-0.4f, 0.4f, 0.0f}, {1.0f, 0.0f, 1.0f} },
+		{ { 0.4f,-0.4f, 0.0f}, {1.0f, 0.0f, 1.0f} },
+		{ { 0.4f, 0.4f, 0.0f}, {1.0f, 0.0f, 1.0f} }
+	};
+	square->AddVertices<PackedColorVertex>(squareVertices, PackColorVertex);
+	square->SetLayout<PackedColorVertexLayout>();
+	std::shared_ptr<VertexBuffer> triangle = std::make_shared<VertexBuffer>(3);
+	VertexData triangleVertices[] = {
+		{ {-0.2f, 0.2f, 0.0f}, {1.0f, 1.0f, 1.0f} },
+		{ {-0.2f,-0.2f, 0.0f}, {1.0f, 1.0f, 1.0f} },
+		{ { 0.2f,-0.2f, 0.0f}, {1.0f, 1.0f, 1.0f} }
+	};
+	triangle->AddVertices<PackedColorVertex>(triangleVertices, PackColorVertex);
+	triangle->SetLayout<PackedColorVertexLayout>();
+
+	for (int row = 0; row < columns; row++) {
+		for (int column = 0; column < columns; column++) {
+			std::shared_ptr<GraphicsObject> root = std::make_shared<GraphicsObject>();
+			root->SetVertexBuffer(square);
+			root->SetPosition(glm::vec3(
+				static_cast<float>(column - columns / 2),
+				static_cast<float>(row - columns / 2), 0.0f));
+			std::shared_ptr<GraphicsObject> child = std::make_shared<GraphicsObject>();
+			child->SetVertexBuffer(triangle);
+			// A little toward the camera, so depth keeps it over the square
+			child->SetPosition(glm::vec3(0.2f, 0.2f, 0.1f));
+			root->AddChild(child);
+			scene.AddObject(root);
+		}
+	}
+}
+
+// Adds a grid of small polygons, three to eight sides, each with its own
+// mesh so nothing is shared or instanced. With an arena the meshes share
+// its blocks and VAOs; without one each has its own buffer and VAO.
+static void AddShapeGrid(Scene& scene, int columns, std::shared_ptr<VertexArena> arena)
+{
+	for (int row = 0; row < columns; row++) {
+		for (int column = 0; column < columns; column++) {
+			int shapeIndex = row * columns + column;
+			int sides = 3 + shapeIndex % 6;
+			glm::vec3 color(
+				(shapeIndex % 7) / 6.0f, (shapeIndex % 11) / 10.0f, (shapeIndex % 13) / 12.0f);
+			// Sizes differ too, so no two meshes are alike
+			float radius = 0.3f + 0.1f * ((shapeIndex / 6) % 2);
+			std::vector<VertexData> vertices;
+			for (int side = 0; side < sides; side++) {
+				float first = glm::two_pi<float>() * side / sides;
+				float second = glm::two_pi<float>() * (side + 1) / sides;
+				vertices.push_back({ { 0.0f, 0.0f, 0.0f }, color });
+				vertices.push_back({ { radius * std::cos(first), radius * std::sin(first), 0.0f }, color });
+				vertices.push_back({ { radius * std::cos(second), radius * std::sin(second), 0.0f }, color });
+			}
+			std::shared_ptr<VertexBuffer> buffer = arena != nullptr ?
+				std::make_shared<VertexBuffer>(arena) : std::make_shared<VertexBuffer>(3);
+			buffer->AddVertices<PackedColorVertex>(vertices, PackColorVertex);
+			buffer->SetLayout<PackedColorVertexLayout>();
+
+			std::shared_ptr<GraphicsObject> shape = std::make_shared<GraphicsObject>();
+			shape->SetVertexBuffer(buffer);
+			shape->SetPosition(glm::vec3(
+				static_cast<float>(column - columns / 2),
+				static_cast<float>(row - columns / 2), 0.0f));
+			scene.AddObject(shape);
+		}
+	}
+}
+
+// Renders the scene into an offscreen target as fast as possible and
+// writes the throughput to the report, for benchmark runs without a display
+static void RunHeadless(
+	Renderer& renderer, const std::shared_ptr<Scene>& scene, int numberOfFrames,
+	std::ostream& report)
+{
+	Framebuffer target(1200, 800);
+	target.Select();
+	glViewport(0, 0, target.GetWidth(), target.GetHeight());
+	renderer.SetViewport(target.GetWidth(), target.GetHeight());
+	glm::mat4 view = CreateViewMatrix(
+		glm::vec3(-10.0f, 0.0f, 1.0f),
+		glm::vec3(0.0f, 0.0f, -1.0f),
+		glm::vec3(0.0f, 1.0f, 0.0f)
+	);
+
+	GLState::ResetCallCounts();
+	GLCallCounter::Reset();
+	auto start = std::chrono::steady_clock::now();
+	for (int frame = 0; frame < numberOfFrames; frame++) {
+		glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		// Turn the objects each frame so every frame has the same work
+		for (auto& object : scene->GetObjects()) {
+			object->ResetOrientation();
+			object->RotateLocalZ(static_cast<float>(frame % 360));
+		}
+		EntityRegistry& registry = scene->GetRegistry();
+		const auto& entities = registry.GetTransforms().GetEntities();
+		for (std::size_t i = 0; i < entities.size(); i++) {
+			const glm::mat4& local = registry.GetTransforms().GetComponents()[i].local;
+			registry.SetLocalMatrix(
+				entities[i], glm::rotate(local, glm::radians(1.0f), glm::vec3(0.0f, 0.0f, 1.0f)));
+		}
+		renderer.RenderScene(scene, view);
+	}
+	// Count the GPU's work too, not only the submission
+	glFinish();
+	double seconds = std::chrono::duration<double>(
+		std::chrono::steady_clock::now() - start).count();
+	target.Deselect();
+
+	const RenderStats& stats = renderer.GetStats();
+	report << "Headless: " << numberOfFrames << " frames in " << seconds
+		<< " s, " << numberOfFrames / seconds << " frames/s, "
+		<< 1000.0 * seconds / numberOfFrames << " ms/frame, "
+		<< stats.draws << " draws/frame, " << scene->GetObjects().size() << " roots, "
+		<< scene->GetRegistry().GetNumberOfEntities() << " entities, "
+		<< renderer.GetNumberOfThreads() << " worker threads, "
+		<< (renderer.IsInstanced() ? "instanced" : "one draw per object")
+		<< (renderer.IsMultiDrawIndirect() ? ", multi-draw indirect" : "") << std::endl;
+	// The switches are the last frame's, the calls are averaged over all
+	// frames. GLState only sees binds and capabilities; the counter sees
+	// every entry point, draws and attribute setup included.
+	report << "GL calls: " << GLCallCounter::GetTotalCalls() / static_cast<double>(numberOfFrames)
+		<< " per frame; program " << stats.programSwitches << ", VAO "
+		<< stats.vertexArraySwitches << ", buffer " << stats.bufferSwitches
+		<< " switches; GLState " << GLState::GetIssuedCalls() / static_cast<double>(numberOfFrames)
+		<< " issued, " << GLState::GetRedundantCalls() / static_cast<double>(numberOfFrames)
+		<< " redundant skipped" << std::endl;
+	GLCallCounter::Report(report, numberOfFrames);
+}
+
 int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
 	_In_opt_ HINSTANCE hPrevInstance,
 	_In_ LPWSTR    lpCmdLine,
 	_In_ int       nCmdShow)
 {
+	// --headless <frames> renders that many frames offscreen and exits.
+	// A Windows subsystem program has no console, so the results go to
+	// the file given by --report <path>. --benchmark <name> runs one of
+	// the Benchmarks on the same hidden context instead. --scene entities
+	// adds a grid of 100k entities to the scene, --scene roots 16k root
+	// objects with a child each, --scene shapes 4096 tiny meshes of their
+	// own and --scene shapes-arena the same meshes in a VertexArena.
+	// --threads <n> sets the renderer's worker threads, for measuring how
+	// it scales. --multi-draw-indirect submits through the indirect path,
+	// which draws each arena block with one call. --per-object-shader
+	// draws with basic.object.vert.glsl, one draw and ObjectUniforms
+	// block per object.
+	int headlessFrames = 0;
+	int numberOfThreads = -1;
+	bool useMultiDrawIndirect = false;
+	bool usePerObjectShader = false;
+	std::wstring sceneName = L"demo";
+	std::wstring benchmarkName;
+	std::wstring reportPath = L"headless-report.txt";
+	std::wistringstream arguments(lpCmdLine);
+	std::wstring argument;
+	while (arguments >> argument) {
+		if (argument == L"--headless") {
+			arguments >> headlessFrames;
+		}
+		else if (argument == L"--threads") {
+			arguments >> numberOfThreads;
+		}
+		else if (argument == L"--multi-draw-indirect") {
+			useMultiDrawIndirect = true;
+		}
+		else if (argument == L"--per-object-shader") {
+			usePerObjectShader = true;
+		}
+		else if (argument == L"--scene") {
+			arguments >> sceneName;
+		}
+		else if (argument == L"--benchmark") {
+			arguments >> benchmarkName;
+		}
+		else if (argument == L"--report") {
+			arguments >> reportPath;
+		}
+	}
+
 	glfwInit();
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	bool isHeadless = headlessFrames > 0 || !benchmarkName.empty();
+	if (isHeadless) {
+		// The context still needs a window, but it is never shown
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	}
 
 	GLFWwindow* window = glfwCreateWindow(1200, 800, "ETSU Computing Interactive Graphics", NULL, NULL);
 	if (window == NULL) {
@@ -64,14 +345,42 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
 		return -1;
 	}
 	glfwMakeContextCurrent(window);
+	if (isHeadless) {
+		glfwSwapInterval(0);
+	}
 
 	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
 		std::cout << "Failed to initialize GLAD" << std::endl;
 		return -1;
 	}
+	if (isHeadless) {
+		// Before any GL object exists, so every call the engine makes goes
+		// through the counter
+		GLCallCounter::Install();
+	}
+
+	if (!benchmarkName.empty()) {
+		std::ofstream report{ std::filesystem::path(reportPath) };
+		// The names are plain ASCII
+		std::string name;
+		for (wchar_t character : benchmarkName) {
+			name += static_cast<char>(character);
+		}
+		bool isFound = Benchmarks::Run(name, report);
+		if (!isFound) {
+			report << "No benchmark named " << name << std::endl;
+		}
+		glfwTerminate();
+		return isFound && report.good() ? 0 : 1;
+	}
 
 	glViewport(0, 0, 1200, 800);
 	glfwSetFramebufferSizeCallback(window, OnWindowSizeChanged);
+	glfwSetCursorPosCallback(window, OnCursorMoved);
+	glfwSetMouseButtonCallback(window, OnMouseButton);
+	glfwSetScrollCallback(window, OnScroll);
+	glfwSetKeyCallback(window, OnKey);
+	glfwSetWindowRefreshCallback(window, OnWindowRefresh);
 	//glfwMaximizeWindow(window);
 
 	const std::string vertexFilePath = "basic.vert.glsl";
@@ -83,12 +392,12 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
 	std::string vertexSource = vertexFile.getData();
 	std::string fragmentSource = fragmentFile.getData();
 
-	unsigned int shaderProgram;
+	// view, projection and world come from the renderer's uniform buffers;
+	// this one reads world per instance, the other from ObjectUniforms
 	std::shared_ptr<Shader> shader = std::make_shared<Shader>(vertexSource, fragmentSource);
-	shader->AddUniform("projection");
-	shader->AddUniform("world");
-	shader->AddUniform("view");
-	shaderProgram = shader->GetShaderProgram();
+	TextFile objectVertexFile("basic.object.vert.glsl");
+	std::shared_ptr<Shader> objectShader = 
+		std::make_shared<Shader>(objectVertexFile.getData(), fragmentSource);
 
 
 	int width, height;
@@ -101,47 +410,93 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
 	float top = 50.0f;
 	left *= aspectRatio;
 	right *= aspectRatio;
-	glm::mat4 projection = glm::ortho(left, right, bottom, top, -1.0f, 1.0f);
+	// The camera sits at z = 1, so these put z = 0 halfway between the
+	// near and far planes rather than exactly on the far one
+	glm::mat4 projection = glm::ortho(left, right, bottom, top, 0.0f, 2.0f);
 
 	std::shared_ptr<Scene> scene = std::make_shared<Scene>();
 
 	std::shared_ptr<GraphicsObject> square = std::make_shared<GraphicsObject>();
-	std::shared_ptr<VertexBuffer> buffer = std::make_shared<VertexBuffer>(6);
-	buffer->AddVertexData(6, -5.0f, 5.0f, 0.0f, 1.0f, 0.0f, 0.0f);
-	buffer->AddVertexData(6, -5.0f, -5.0f, 0.0f, 1.0f, 0.0f, 0.0f);
-	buffer->AddVertexData(6, 5.0f, -5.0f, 0.0f, 1.0f, 0.0f, 0.0f);
-	buffer->AddVertexData(6, -5.0f, 5.0f, 0.0f, 0.0f, 0.0f, 1.0f);
-	buffer->AddVertexData(6, 5.0f, -5.0f, 0.0f, 0.0f, 0.0f, 1.0f);
-	buffer->AddVertexData(6, 5.0f, 5.0f, 0.0f, 0.0f, 0.0f, 1.0f);
-	buffer->AddVertexAttribute("position", 0, 3);
-	buffer->AddVertexAttribute("color", 1, 3, 3);
+	// Packed vertices are three 32-bit words, see PackedColorVertex
+	std::shared_ptr<VertexBuffer> buffer = std::make_shared<VertexBuffer>(3);
+	VertexData squareVertices[] = {
+		{ {-5.0f, 5.0f, 0.0f}, {1.0f, 0.0f, 0.0f} },
+		{ {-5.0f,-5.0f, 0.0f}, {1.0f, 0.0f, 0.0f} },
+		{ { 5.0f,-5.0f, 0.0f}, {1.0f, 0.0f, 0.0f} },
+		{ {-5.0f, 5.0f, 0.0f}, {0.0f, 0.0f, 1.0f} },
+		{ { 5.0f,-5.0f, 0.0f}, {0.0f, 0.0f, 1.0f} },
+		{ { 5.0f, 5.0f, 0.0f}, {0.0f, 0.0f, 1.0f} }
+	};
+	buffer->AddVertices<PackedColorVertex>(squareVertices, PackColorVertex);
+	buffer->SetLayout<PackedColorVertexLayout>();
 	square->SetVertexBuffer(buffer);
 	scene->AddObject(square);
 
 	std::shared_ptr<GraphicsObject> triangle = std::make_shared<GraphicsObject>();
-	std::shared_ptr<VertexBuffer> buffer2 = std::make_shared<VertexBuffer>(6);
-	buffer2->AddVertexData(6, -5.0f, 5.0f, 0.0f, 0.0f, 1.0f, 0.0f);
-	buffer2->AddVertexData(6, -5.0f, -5.0f, 0.0f, 0.0f, 1.0f, 0.0f);
-	buffer2->AddVertexData(6, 5.0f, -5.0f, 0.0f, 0.0f, 1.0f, 0.0f);
-	buffer2->AddVertexAttribute("position", 0, 3);
-	buffer2->AddVertexAttribute("color", 1, 3, 3);
+	std::shared_ptr<VertexBuffer> buffer2 = std::make_shared<VertexBuffer>(3);
+	VertexData triangleVertices[] = {
+		{ {-5.0f, 5.0f, 0.0f}, {0.0f, 1.0f, 0.0f} },
+		{ {-5.0f,-5.0f, 0.0f}, {0.0f, 1.0f, 0.0f} },
+		{ { 5.0f,-5.0f, 0.0f}, {0.0f, 1.0f, 0.0f} }
+	};
+	buffer2->AddVertices<PackedColorVertex>(triangleVertices, PackColorVertex);
+	buffer2->SetLayout<PackedColorVertexLayout>();
 	triangle->SetVertexBuffer(buffer2);
 	triangle->SetPosition(glm::vec3(30.0f, 0.0f, 0.0f));
 	scene->AddObject(triangle);
 
 	std::shared_ptr<GraphicsObject> line = std::make_shared<GraphicsObject>();
-	std::shared_ptr<VertexBuffer> buffer3 = std::make_shared<VertexBuffer>(6);
+	std::shared_ptr<VertexBuffer> buffer3 = std::make_shared<VertexBuffer>(3);
 	buffer3->SetPrimitiveType(GL_LINES);
-	buffer3->AddVertexData(6, 0.0f,  2.5f, 0.0f, 0.0f, 1.0f, 0.0f);
-	buffer3->AddVertexData(6, 0.0f, -2.5f, 0.0f, 0.0f, 1.0f, 0.0f);
-	buffer3->AddVertexAttribute("position", 0, 3);
-	buffer3->AddVertexAttribute("color", 1, 3, 3);
+	VertexData lineVertices[] = {
+		{ {0.0f, 2.5f, 0.0f}, {0.0f, 1.0f, 0.0f} },
+		{ {0.0f,-2.5f, 0.0f}, {0.0f, 1.0f, 0.0f} }
+	};
+	buffer3->AddVertices<PackedColorVertex>(lineVertices, PackColorVertex);
+	buffer3->SetLayout<PackedColorVertexLayout>();
 	line->SetVertexBuffer(buffer3);
 	line->SetPosition(glm::vec3(5.0f, -10.0f, 0.0f));
 	triangle->AddChild(line);
 
-	Renderer renderer(shader);
+	bool isSceneKnown = true;
+	if (sceneName == L"entities") {
+		AddEntityGrid(*scene, 316);
+	}
+	else if (sceneName == L"roots") {
+		AddObjectGrid(*scene, 128);
+	}
+	else if (sceneName == L"shapes") {
+		AddShapeGrid(*scene, 64, nullptr);
+	}
+	else if (sceneName == L"shapes-arena") {
+		// Blocks of 64k packed vertices, a few hundred kilobytes each
+		std::shared_ptr<VertexArena> arena = 
+			std::make_shared<VertexArena>(sizeof(PackedColorVertex), 65536);
+		arena->SetLayout<PackedColorVertexLayout>();
+		AddShapeGrid(*scene, 64, arena);
+	}
+	else if (sceneName != L"demo") {
+		isSceneKnown = false;
+	}
+
+	Renderer renderer(usePerObjectShader ? objectShader : shader, numberOfThreads >= 0 ?
+		static_cast<std::size_t>(numberOfThreads) : WorkerPool::DefaultNumberOfThreads());
 	renderer.allocateVertexBuffers(scene->GetObjects());
+	renderer.SetProjection(projection);
+	renderer.SetMultiDrawIndirect(useMultiDrawIndirect);
+
+	if (headlessFrames > 0) {
+		std::ofstream report{ std::filesystem::path(reportPath) };
+		if (!isSceneKnown) {
+			report << "No scene of that name" << std::endl;
+			glfwTerminate();
+			return 1;
+		}
+		RunHeadless(renderer, scene, headlessFrames, report);
+		glfwTerminate();
+		// Nonzero when the report could not be written
+		return report.good() ? 0 : 1;
+	}
 
 	IMGUI_CHECKVERSION();
 	ImGui::CreateContext();
@@ -152,57 +507,151 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
 
 	glm::vec3 clearColor = { 0.2f, 0.3f, 0.3f };
 
-	glUseProgram(shaderProgram);
-
-	shader->SendMat4Uniform("projection", projection);
-
 	float angle = 0, childAngle = 0;
+	float oldAngle = -1, oldChildAngle = -1;
 	float cameraX = -10, cameraY = 0;
 	glm::mat4 view;
+	// The profiler's queries and the picker's GL objects are deleted at
+	// the end of this block, while the context is still alive
+	{
+		FrameProfiler profiler;
+		// The last left click's pick, and how long the CPU pick took
+		bool useGpuPicking = false;
+		GpuPicker gpuPicker;
+		PickResult picked = { nullptr, Entity(), PickResult::noPrimitive, 0.0f, glm::vec3(0.0f) };
+		double pickMicroseconds = 0;
+
+		// Even when idle, wake up now and then to check for closing
+		const double idleTimeout = 0.5;
+
+		while (!glfwWindowShouldClose(window)) {
+			// Nothing has changed since the last frame, wait for something to
+			if (!FrameInvalidation::ConsumeFrame()) {
+				glfwWaitEventsTimeout(idleTimeout);
+				continue;
+			}
+			profiler.BeginFrame();
+			ProcessInput(window);
+
+			glClearColor(clearColor.r, clearColor.g, clearColor.b, 1.0f);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+			view = CreateViewMatrix(
+				glm::vec3(cameraX, cameraY, 1.0f),
+				glm::vec3(0.0f, 0.0f, -1.0f),
+				glm::vec3(0.0f, 1.0f, 0.0f)
+			);
+
+			// Update the objects in the scene
+			// Only when the angles change, as that invalidates the next frame
+			std::size_t updateZone = profiler.BeginZone("Update");
+			if (angle != oldAngle || childAngle != oldChildAngle) {
+				for (auto& object : scene->GetObjects()) {
+					object->ResetOrientation();
+					object->RotateLocalZ(angle);
+					for (auto& child : object->GetChildren()) {
+						child->ResetOrientation();
+						child->RotateLocalZ(childAngle);
+					}
+				}
+				oldAngle = angle;
+				oldChildAngle = childAngle;
+			}
+			profiler.EndZone(updateZone);
+
+
+			glfwGetFramebufferSize(window, &width, &height);
+			renderer.SetViewport(width, height);
+			renderer.SetShader(usePerObjectShader ? objectShader : shader);
+			renderer.SetMultiDrawIndirect(useMultiDrawIndirect);
+			GLState::ResetCallCounts();
+			std::size_t renderZone = profiler.BeginZone("Render");
+			renderer.RenderScene(scene, view);
+			profiler.EndZone(renderZone);
+
+			std::size_t imGuiZone = profiler.BeginZone("ImGui");
+			ImGui_ImplOpenGL3_NewFrame();
+			ImGui_ImplGlfw_NewFrame();
+			ImGui::NewFrame();
+
+			// Clicks on the panel are ImGui's
+			if (ImGui::IsMouseClicked(ImGuiMouseButton_Left) && !io.WantCaptureMouse) {
+				double cursorX, cursorY;
+				int windowWidth, windowHeight;
+				glfwGetCursorPos(window, &cursorX, &cursorY);
+				glfwGetWindowSize(window, &windowWidth, &windowHeight);
+				if (useGpuPicking) {
+					gpuPicker.Request(*scene, view, projection,
+						cursorX, cursorY, windowWidth, windowHeight);
+				}
+				else {
+					auto start = std::chrono::steady_clock::now();
+					Ray ray = Picking::ScreenToRay(
+						cursorX, cursorY, windowWidth, windowHeight, view, projection);
+					picked = Picking::Pick(*scene, ray);
+					pickMicroseconds = std::chrono::duration<double, std::micro>(
+						std::chrono::steady_clock::now() - start).count();
+				}
+			}
+			if (gpuPicker.IsPending() && !gpuPicker.Poll(*scene, picked)) {
+				// Keep drawing frames until the readback arrives
+				FrameInvalidation::Invalidate();
+			}
 
-	while (!glfwWindowShouldClose(window)) {
-		ProcessInput(window);
-
-		glClearColor(clearColor.r, clearColor.g, clearColor.b, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT);
-
-		view = CreateViewMatrix(
-			glm::vec3(cameraX, cameraY, 1.0f),
-			glm::vec3(0.0f, 0.0f, -1.0f),
-			glm::vec3(0.0f, 1.0f, 0.0f)
-		);
-
-		// Update the objects in the scene
-		for (auto& object : scene->GetObjects()) {
-			object->ResetOrientation();
-			object->RotateLocalZ(angle);
-			for (auto& child : object->GetChildren()) {
-				child->ResetOrientation();
-				child->RotateLocalZ(childAngle);
+			ImGui::Begin("Computing Interactive Graphics");
+			ImGui::Text(shader->GetLog().c_str());
+			ImGui::Text("Application average %.3f ms/frame (%.1f FPS)",
+				1000.0f / io.Framerate, io.Framerate);
+			const RenderStats& stats = renderer.GetStats();
+			ImGui::Text("Draws %u (%u objects, %s), program %u, VAO %u, buffer %u switches",
+				stats.draws, stats.instances,
+				renderer.IsInstanced() ? "instanced" : "one per object",
+				stats.programSwitches, stats.vertexArraySwitches,
+				stats.bufferSwitches);
+			ImGui::Text("Culled %u objects or subtrees", stats.culled);
+			ImGui::Text("Vertex memory: CPU %lld bytes, GPU %lld bytes",
+				VertexMemory::GetCpuBytes(), VertexMemory::GetGpuBytes());
+			ImGui::Text("GL state calls: %llu issued, %llu redundant skipped",
+				GLState::GetIssuedCalls(), GLState::GetRedundantCalls());
+			ShowProfilerPanel(profiler);
+			if (!picked.IsHit()) {
+				ImGui::Text("Picked nothing");
+			}
+			else if (picked.primitive == PickResult::noPrimitive) {
+				ImGui::Text("Picked %s", picked.object != nullptr ? "an object" : "an entity");
+			}
+			else {
+				ImGui::Text("Picked %s, triangle %u",
+					picked.object != nullptr ? "an object" : "an entity", picked.primitive);
+			}
+			if (!useGpuPicking) {
+				ImGui::Text("at (%.2f, %.2f, %.2f) in %.1f us",
+					picked.point.x, picked.point.y, picked.point.z, pickMicroseconds);
 			}
+			ImGui::Checkbox("GPU picking", &useGpuPicking);
+			bool isChanged = false;
+			isChanged |= ImGui::Checkbox("Per-object shader", &usePerObjectShader);
+			isChanged |= ImGui::Checkbox("Multi-draw indirect", &useMultiDrawIndirect);
+			isChanged |= ImGui::ColorEdit3("Background color", (float*)&clearColor.r);
+			isChanged |= ImGui::SliderFloat("Angle", &angle, 0, 360);
+			isChanged |= ImGui::SliderFloat("Child Angle", &childAngle, 0, 360);
+			isChanged |= ImGui::SliderFloat("Camera X", &cameraX, left, right);
+			isChanged |= ImGui::SliderFloat("Camera Y", &cameraY, bottom, top);
+			ImGui::End();
+			if (isChanged) {
+				// The camera, colour and draw path take effect next frame
+				FrameInvalidation::Invalidate();
+			}
+			ImGui::Render();
+			ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+			// ImGui sets GL state directly rather than through GLState
+			GLState::Invalidate();
+			profiler.EndZone(imGuiZone);
+
+			glfwSwapBuffers(window);
+			profiler.EndFrame();
+			glfwPollEvents();
 		}
-
-
-		renderer.RenderScene(scene, view);
-
-		ImGui_ImplOpenGL3_NewFrame();
-		ImGui_ImplGlfw_NewFrame();
-		ImGui::NewFrame();
-		ImGui::Begin("Computing Interactive Graphics");
-		ImGui::Text(shader->GetLog().c_str());
-		ImGui::Text("Application average %.3f ms/frame (%.1f FPS)",
-			1000.0f / io.Framerate, io.Framerate);
-		ImGui::ColorEdit3("Background color", (float*)&clearColor.r);
-		ImGui::SliderFloat("Angle", &angle, 0, 360);
-		ImGui::SliderFloat("Child Angle", &childAngle, 0, 360);
-		ImGui::SliderFloat("Camera X", &cameraX, left, right);
-		ImGui::SliderFloat("Camera Y", &cameraY, bottom, top);
-		ImGui::End();
-		ImGui::Render();
-		ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
-
-		glfwSwapBuffers(window);
-		glfwPollEvents();
 	}
 
 	ImGui_ImplOpenGL3_Shutdown();
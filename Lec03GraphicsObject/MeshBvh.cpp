@@ -0,0 +1,232 @@
+#include "MeshBvh.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <utility>
+
+MeshBvh::MeshBvh(std::span<const glm::vec3> positions, std::span<const unsigned int> indices)
+{
+	std::size_t numberOfTriangles = indices.empty() ? positions.size() / 3 : indices.size() / 3;
+	std::vector<glm::vec3> triangleCorners(numberOfTriangles * 3);
+	for (std::size_t i = 0; i < triangleCorners.size(); i++) {
+		std::size_t vertex = indices.empty() ? i : indices[i];
+		if (vertex >= positions.size()) {
+			throw "Index out of range!";
+		}
+		triangleCorners[i] = positions[vertex];
+	}
+	if (numberOfTriangles == 0) {
+		return;
+	}
+
+	std::vector<BoundingBox> triangleBoxes(numberOfTriangles);
+	std::vector<glm::vec3> centroids(numberOfTriangles);
+	BoundingBox box;
+	for (std::size_t i = 0; i < numberOfTriangles; i++) {
+		for (int corner = 0; corner < 3; corner++) {
+			triangleBoxes[i].Include(triangleCorners[i * 3 + corner]);
+		}
+		centroids[i] = triangleBoxes[i].GetCenter();
+		box.Include(triangleBoxes[i]);
+	}
+	std::vector<unsigned int> triangles(numberOfTriangles);
+	std::iota(triangles.begin(), triangles.end(), 0);
+
+	// A binary tree with a leaf per triangle at most has 2n - 1 nodes
+	nodes.reserve(numberOfTriangles * 2);
+	nodes.push_back({ box, 0, static_cast<unsigned int>(numberOfTriangles) });
+	Subdivide(0, triangles, triangleBoxes, centroids);
+	nodes.shrink_to_fit();
+
+	corners.resize(numberOfTriangles * 3);
+	for (std::size_t i = 0; i < numberOfTriangles; i++) {
+		for (int corner = 0; corner < 3; corner++) {
+			corners[i * 3 + corner] = triangleCorners[triangles[i] * 3 + corner];
+		}
+	}
+	primitives = std::move(triangles);
+}
+
+bool MeshBvh::Raycast(const Ray& ray, float maxDistance, MeshHit& hit) const
+{
+	float entry;
+	if (nodes.empty() || !nodes[0].box.Intersects(ray, maxDistance, entry)) {
+		return false;
+	}
+	bool isHit = false;
+	float closest = maxDistance;
+	std::vector<std::pair<unsigned int, float>> stack;
+	stack.reserve(64);
+	stack.push_back({ 0, entry });
+	while (!stack.empty()) {
+		auto [nodeIndex, nodeEntry] = stack.back();
+		stack.pop_back();
+		// A closer hit was found since the node was pushed
+		if (nodeEntry > closest) {
+			continue;
+		}
+		const Node& node = nodes[nodeIndex];
+		if (node.count > 0) {
+			for (unsigned int i = node.first; i < node.first + node.count; i++) {
+				float distance;
+				glm::vec2 barycentric;
+				if (IntersectTriangle(ray, corners[i * 3], corners[i * 3 + 1], corners[i * 3 + 2],
+					distance, barycentric) && distance <= closest) {
+					closest = distance;
+					hit = { primitives[i], distance, barycentric };
+					isHit = true;
+				}
+			}
+			continue;
+		}
+
+		// The nearer child goes on top, so its hits can rule out the other
+		float entries[2] = { 0.0f, 0.0f };
+		bool isEntered[2];
+		for (int child = 0; child < 2; child++) {
+			isEntered[child] = nodes[node.first + child].box.Intersects(
+				ray, closest, entries[child]);
+		}
+		int nearer = entries[1] < entries[0] && isEntered[1] ? 1 : 0;
+		int farther = 1 - nearer;
+		if (isEntered[farther]) {
+			stack.push_back({ node.first + farther, entries[farther] });
+		}
+		if (isEntered[nearer]) {
+			stack.push_back({ node.first + nearer, entries[nearer] });
+		}
+	}
+	return isHit;
+}
+
+void MeshBvh::Subdivide(
+	unsigned int nodeIndex, std::vector<unsigned int>& triangles,
+	const std::vector<BoundingBox>& triangleBoxes,
+	const std::vector<glm::vec3>& centroids)
+{
+	const unsigned int maxLeafSize = 4;
+	const int numberOfBins = 12;
+	// Copied, as adding the children may move the nodes
+	Node node = nodes[nodeIndex];
+	if (node.count <= maxLeafSize) {
+		return;
+	}
+
+	// Bin the centroids along the axis they spread over most
+	BoundingBox centroidBox;
+	for (unsigned int i = node.first; i < node.first + node.count; i++) {
+		centroidBox.Include(centroids[triangles[i]]);
+	}
+	glm::vec3 extents = centroidBox.max - centroidBox.min;
+	int axis = 0;
+	if (extents.y > extents[axis]) {
+		axis = 1;
+	}
+	if (extents.z > extents[axis]) {
+		axis = 2;
+	}
+	if (extents[axis] <= 0.0f) {
+		// Every centroid is in one place, no split separates them
+		return;
+	}
+	float binScale = numberOfBins / extents[axis];
+	float binOrigin = centroidBox.min[axis];
+	auto getBin = [&](unsigned int triangle) {
+		int bin = static_cast<int>((centroids[triangle][axis] - binOrigin) * binScale);
+		return std::min(bin, numberOfBins - 1);
+	};
+
+	BoundingBox binBoxes[numberOfBins];
+	unsigned int binCounts[numberOfBins] = {};
+	for (unsigned int i = node.first; i < node.first + node.count; i++) {
+		int bin = getBin(triangles[i]);
+		binBoxes[bin].Include(triangleBoxes[triangles[i]]);
+		binCounts[bin]++;
+	}
+
+	// Sweep from the left, then from the right, pricing the split before
+	// each bin
+	float leftCosts[numberOfBins] = {};
+	unsigned int leftCounts[numberOfBins] = {};
+	BoundingBox leftBox;
+	unsigned int leftCount = 0;
+	for (int bin = 1; bin < numberOfBins; bin++) {
+		leftBox.Include(binBoxes[bin - 1]);
+		leftCount += binCounts[bin - 1];
+		leftCounts[bin] = leftCount;
+		leftCosts[bin] = leftCount * leftBox.GetHalfArea();
+	}
+	float bestCost = node.count * node.box.GetHalfArea();
+	int bestSplit = -1;
+	BoundingBox rightBox;
+	unsigned int rightCount = 0;
+	for (int bin = numberOfBins - 1; bin > 0; bin--) {
+		rightBox.Include(binBoxes[bin]);
+		rightCount += binCounts[bin];
+		if (leftCounts[bin] == 0 || rightCount == 0) {
+			continue;
+		}
+		float cost = leftCosts[bin] + rightCount * rightBox.GetHalfArea();
+		if (cost < bestCost) {
+			bestCost = cost;
+			bestSplit = bin;
+		}
+	}
+	if (bestSplit < 0) {
+		return;
+	}
+
+	auto begin = triangles.begin() + node.first;
+	auto middle = std::partition(begin, begin + node.count,
+		[&](unsigned int triangle) { return getBin(triangle) < bestSplit; });
+	unsigned int numberOnLeft = static_cast<unsigned int>(middle - begin);
+	Node children[2] = {
+		{ BoundingBox(), node.first, numberOnLeft },
+		{ BoundingBox(), node.first + numberOnLeft, node.count - numberOnLeft }
+	};
+	for (Node& child : children) {
+		for (unsigned int i = child.first; i < child.first + child.count; i++) {
+			child.box.Include(triangleBoxes[triangles[i]]);
+		}
+	}
+	unsigned int firstChild = static_cast<unsigned int>(nodes.size());
+	nodes.push_back(children[0]);
+	nodes.push_back(children[1]);
+	nodes[nodeIndex].first = firstChild;
+	nodes[nodeIndex].count = 0;
+	Subdivide(firstChild, triangles, triangleBoxes, centroids);
+	Subdivide(firstChild + 1, triangles, triangleBoxes, centroids);
+}
+
+bool MeshBvh::IntersectTriangle(
+	const Ray& ray, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c,
+	float& distance, glm::vec2& barycentric)
+{
+	// Moller-Trumbore: solve origin + t * direction = a + u * ab + v * ac
+	glm::vec3 edge1 = b - a;
+	glm::vec3 edge2 = c - a;
+	glm::vec3 p = glm::cross(ray.direction, edge2);
+	float determinant = glm::dot(edge1, p);
+	if (determinant == 0.0f) {
+		// The ray runs parallel to the triangle
+		return false;
+	}
+	float inverse = 1.0f / determinant;
+	glm::vec3 s = ray.origin - a;
+	float u = glm::dot(s, p) * inverse;
+	if (u < 0.0f || u > 1.0f) {
+		return false;
+	}
+	glm::vec3 q = glm::cross(s, edge1);
+	float v = glm::dot(ray.direction, q) * inverse;
+	if (v < 0.0f || u + v > 1.0f) {
+		return false;
+	}
+	float t = glm::dot(edge2, q) * inverse;
+	if (t < 0.0f) {
+		return false;
+	}
+	distance = t;
+	barycentric = glm::vec2(u, v);
+	return true;
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <span>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Bounds.h"
+
+// Where a ray hit a mesh
+struct MeshHit {
+	// The triangle's index in draw order
+	unsigned int primitive;
+	float distance;
+	// Weights of the triangle's second and third corners at the hit
+	glm::vec2 barycentric;
+};
+
+// A bounding volume hierarchy over the triangles of one mesh, for ray
+// queries in the mesh's local space. Built once from the positions with
+// binned surface area splits; the triangles are copied in leaf order so
+// a leaf's corners are read one after the other.
+class MeshBvh
+{
+private:
+	struct Node {
+		BoundingBox box;
+		// The first child (the second follows it) or the first triangle
+		unsigned int first;
+		// Triangles in a leaf, 0 for inner nodes
+		unsigned int count;
+	};
+	std::vector<Node> nodes;
+	// Three corners per triangle, in leaf order
+	std::vector<glm::vec3> corners;
+	// Per triangle in leaf order, its index in draw order
+	std::vector<unsigned int> primitives;
+
+public:
+	// Every three indices make a triangle; without indices every three
+	// positions do
+	MeshBvh(std::span<const glm::vec3> positions, std::span<const unsigned int> indices);
+	~MeshBvh() = default;
+
+	inline std::size_t GetNumberOfTriangles() const { return primitives.size(); }
+	inline std::size_t GetNumberOfNodes() const { return nodes.size(); }
+
+	// The closest triangle, front or back, the ray hits within maxDistance
+	bool Raycast(const Ray& ray, float maxDistance, MeshHit& hit) const;
+
+private:
+	// Splits the node's triangles where the summed area of the halves'
+	// boxes, weighted by their triangle counts, is smallest
+	void Subdivide(
+		unsigned int nodeIndex, std::vector<unsigned int>& triangles,
+		const std::vector<BoundingBox>& triangleBoxes,
+		const std::vector<glm::vec3>& centroids);
+	static bool IntersectTriangle(
+		const Ray& ray, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c,
+		float& distance, glm::vec2& barycentric);
+};
@@ -0,0 +1,203 @@
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cmath>
+#include <deque>
+
+namespace {
+	// Tuning values from Forsyth's paper
+	const unsigned int forsythCacheSize = 32;
+	const float cacheDecayPower = 1.5f;
+	const float lastTriangleScore = 0.75f;
+	const float valenceBoostScale = 2.0f;
+	const float valenceBoostPower = 0.5f;
+
+	float ScoreVertex(int cachePosition, unsigned int remainingTriangles)
+	{
+		if (remainingTriangles == 0) {
+			// Nothing left to draw with this vertex
+			return -1.0f;
+		}
+		float score = 0.0f;
+		if (cachePosition >= 0) {
+			if (cachePosition < 3) {
+				// Used by the last triangle, a fixed score stops the
+				// optimizer favouring strip-like orders too much
+				score = lastTriangleScore;
+			}
+			else {
+				const float scaler = 1.0f / (forsythCacheSize - 3.0f);
+				score = std::pow(1.0f - (cachePosition - 3) * scaler, cacheDecayPower);
+			}
+		}
+		// Vertices with few triangles left get priority so they can leave
+		score += valenceBoostScale * 
+			std::pow(static_cast<float>(remainingTriangles), -valenceBoostPower);
+		return score;
+	}
+}
+
+float MeshOptimizer::ComputeACMR(
+	std::span<const unsigned int> indices, unsigned int numberOfVertices,
+	unsigned int cacheSize)
+{
+	ValidateIndices(indices, numberOfVertices, true);
+	if (indices.size() < 3) {
+		return 0.0f;
+	}
+	std::vector<bool> isCached(numberOfVertices, false);
+	std::deque<unsigned int> cache;
+	unsigned int misses = 0;
+	for (unsigned int index : indices) {
+		if (isCached[index]) {
+			continue;
+		}
+		misses++;
+		cache.push_back(index);
+		isCached[index] = true;
+		if (cache.size() > cacheSize) {
+			isCached[cache.front()] = false;
+			cache.pop_front();
+		}
+	}
+	return static_cast<float>(misses) / (indices.size() / 3);
+}
+
+std::vector<unsigned int> MeshOptimizer::OptimizeVertexCache(
+	std::span<const unsigned int> indices, unsigned int numberOfVertices)
+{
+	ValidateIndices(indices, numberOfVertices, true);
+	const std::size_t numberOfTriangles = indices.size() / 3;
+
+	// Triangles using each vertex, packed: vertex v owns
+	// adjacency[firstAdjacent[v], firstAdjacent[v] + remaining[v])
+	std::vector<unsigned int> remaining(numberOfVertices, 0);
+	for (unsigned int index : indices) {
+		remaining[index]++;
+	}
+	std::vector<unsigned int> firstAdjacent(numberOfVertices + 1, 0);
+	for (unsigned int v = 0; v < numberOfVertices; v++) {
+		firstAdjacent[v + 1] = firstAdjacent[v] + remaining[v];
+	}
+	std::vector<unsigned int> adjacency(indices.size());
+	std::vector<unsigned int> filled(numberOfVertices, 0);
+	for (std::size_t i = 0; i < indices.size(); i++) {
+		unsigned int v = indices[i];
+		adjacency[firstAdjacent[v] + filled[v]++] = static_cast<unsigned int>(i / 3);
+	}
+
+	std::vector<int> cachePosition(numberOfVertices, -1);
+	std::vector<float> vertexScore(numberOfVertices);
+	for (unsigned int v = 0; v < numberOfVertices; v++) {
+		vertexScore[v] = ScoreVertex(-1, remaining[v]);
+	}
+	std::vector<bool> isEmitted(numberOfTriangles, false);
+
+	std::vector<unsigned int> optimized;
+	optimized.reserve(numberOfTriangles * 3);
+	// The LRU cache, with room for the three vertices pushed per triangle
+	std::vector<unsigned int> cache;
+	cache.reserve(forsythCacheSize + 3);
+	std::vector<unsigned int> nextCache;
+	nextCache.reserve(forsythCacheSize + 3);
+
+	std::size_t scanCursor = 0;
+	long long bestTriangle = -1;
+	for (std::size_t emitted = 0; emitted < numberOfTriangles; emitted++) {
+		if (bestTriangle < 0) {
+			// Nothing in the cache scores, start on the next unused triangle
+			while (isEmitted[scanCursor]) {
+				scanCursor++;
+			}
+			bestTriangle = static_cast<long long>(scanCursor);
+		}
+		std::size_t t = static_cast<std::size_t>(bestTriangle);
+		isEmitted[t] = true;
+
+		// Emit, take the triangle off its vertices and put them in front
+		nextCache.clear();
+		for (int corner = 0; corner < 3; corner++) {
+			unsigned int v = indices[t * 3 + corner];
+			optimized.push_back(v);
+			unsigned int* first = adjacency.data() + firstAdjacent[v];
+			unsigned int* last = first + remaining[v];
+			*std::find(first, last, static_cast<unsigned int>(t)) = *(last - 1);
+			remaining[v]--;
+			if (std::find(nextCache.begin(), nextCache.end(), v) == nextCache.end()) {
+				nextCache.push_back(v);
+			}
+		}
+		for (unsigned int v : cache) {
+			if (std::find(nextCache.begin(), nextCache.end(), v) == nextCache.end()) {
+				nextCache.push_back(v);
+			}
+		}
+		std::swap(cache, nextCache);
+
+		// Rescore the cached vertices, and the ones pushed out of the cache
+		for (std::size_t position = 0; position < cache.size(); position++) {
+			unsigned int v = cache[position];
+			int newPosition = 
+				position < forsythCacheSize ? static_cast<int>(position) : -1;
+			cachePosition[v] = newPosition;
+			vertexScore[v] = ScoreVertex(newPosition, remaining[v]);
+		}
+		if (cache.size() > forsythCacheSize) {
+			cache.resize(forsythCacheSize);
+		}
+
+		// Only triangles around those vertices changed score
+		bestTriangle = -1;
+		float bestScore = -1.0f;
+		for (const std::vector<unsigned int>* vertices : { &cache, &nextCache }) {
+			for (unsigned int v : *vertices) {
+				for (unsigned int a = 0; a < remaining[v]; a++) {
+					unsigned int adjacent = adjacency[firstAdjacent[v] + a];
+					float score = 
+						vertexScore[indices[adjacent * 3]] + 
+						vertexScore[indices[adjacent * 3 + 1]] +
+						vertexScore[indices[adjacent * 3 + 2]];
+					if (score > bestScore) {
+						bestScore = score;
+						bestTriangle = adjacent;
+					}
+				}
+			}
+		}
+	}
+	return optimized;
+}
+
+std::vector<unsigned int> MeshOptimizer::OptimizeVertexFetch(
+	std::vector<unsigned int>& indices, unsigned int numberOfVertices)
+{
+	ValidateIndices(indices, numberOfVertices, false);
+	const unsigned int unused = ~0u;
+	std::vector<unsigned int> remap(numberOfVertices, unused);
+	unsigned int nextVertex = 0;
+	for (unsigned int& index : indices) {
+		if (remap[index] == unused) {
+			remap[index] = nextVertex++;
+		}
+		index = remap[index];
+	}
+	for (unsigned int& newIndex : remap) {
+		if (newIndex == unused) {
+			newIndex = nextVertex++;
+		}
+	}
+	return remap;
+}
+
+void MeshOptimizer::ValidateIndices(
+	std::span<const unsigned int> indices, unsigned int numberOfVertices,
+	bool isTriangleList)
+{
+	if (isTriangleList && indices.size() % 3 != 0) {
+		throw "Index count is not a multiple of three!";
+	}
+	for (unsigned int index : indices) {
+		if (index >= numberOfVertices) {
+			throw "Index out of range!";
+		}
+	}
+}
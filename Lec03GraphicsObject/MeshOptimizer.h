@@ -0,0 +1,33 @@
+#pragma once
+#include <span>
+#include <vector>
+
+// Index-level passes that reorder indexed triangle lists for the GPU. Each
+// throws if an index is out of range, and the triangle passes if the
+// index count is not a multiple of three.
+class MeshOptimizer
+{
+public:
+	// Average cache miss ratio: vertex shader runs per triangle for a FIFO
+	// post-transform cache of the given size. 3 is the worst case, about
+	// 0.5 to 0.7 is what a well ordered regular mesh reaches.
+	static float ComputeACMR(
+		std::span<const unsigned int> indices, unsigned int numberOfVertices,
+		unsigned int cacheSize = 16);
+
+	// Reorders the triangles with Tom Forsyth's linear-speed vertex cache
+	// optimization so that triangles reuse recently transformed vertices
+	static std::vector<unsigned int> OptimizeVertexCache(
+		std::span<const unsigned int> indices, unsigned int numberOfVertices);
+
+	// Renumbers the vertices in order of first use so vertex fetches walk
+	// memory forward. Rewrites the indices and returns the old-to-new
+	// vertex map; unreferenced vertices go last.
+	static std::vector<unsigned int> OptimizeVertexFetch(
+		std::vector<unsigned int>& indices, unsigned int numberOfVertices);
+
+private:
+	static void ValidateIndices(
+		std::span<const unsigned int> indices, unsigned int numberOfVertices,
+		bool isTriangleList);
+};
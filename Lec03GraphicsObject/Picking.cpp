@@ -0,0 +1,110 @@
+#include "Picking.h"
+#include <vector>
+
+Ray Picking::ScreenToRay(
+	double cursorX, double cursorY, int width, int height,
+	const glm::mat4& view, const glm::mat4& projection)
+{
+	// Window y runs down, normalized device y runs up
+	glm::vec2 ndc(
+		2.0f * static_cast<float>(cursorX) / width - 1.0f,
+		1.0f - 2.0f * static_cast<float>(cursorY) / height);
+	glm::mat4 inverse = glm::inverse(projection * view);
+	glm::vec4 nearPoint = inverse * glm::vec4(ndc, -1.0f, 1.0f);
+	glm::vec4 farPoint = inverse * glm::vec4(ndc, 1.0f, 1.0f);
+	glm::vec3 origin = glm::vec3(nearPoint) / nearPoint.w;
+	glm::vec3 end = glm::vec3(farPoint) / farPoint.w;
+	return { origin, glm::normalize(end - origin) };
+}
+
+PickResult Picking::Pick(Scene& scene, const Ray& ray, float maxDistance)
+{
+	PickResult best = { nullptr, Entity(), PickResult::noPrimitive, maxDistance, glm::vec3(0.0f) };
+	std::vector<SpatialIndexHit> candidates;
+	scene.GetObjectIndex().Query(ray, maxDistance, candidates);
+	for (const SpatialIndexHit& candidate : candidates) {
+		// Nearest first, so no later root can beat the best hit
+		if (candidate.distance > best.distance) {
+			break;
+		}
+		PickObject(*scene.GetObjects()[candidate.item], ray, best);
+	}
+
+	EntityRegistry& registry = scene.GetRegistry();
+	candidates.clear();
+	registry.GetSpatialIndex().Query(ray, best.distance, candidates);
+	for (const SpatialIndexHit& candidate : candidates) {
+		if (candidate.distance > best.distance) {
+			break;
+		}
+		Entity entity = Entity::FromKey(candidate.item);
+		// AddMesh gave every indexed entity all of these
+		if (registry.GetVisibilities().Get(entity).isHidden) {
+			continue;
+		}
+		if (PickMesh(*registry.GetMeshes().Get(entity).buffer,
+			registry.GetTransforms().Get(entity).world,
+			registry.GetBounds().Get(entity).worldBox, ray, best)) {
+			best.object = nullptr;
+			best.entity = entity;
+		}
+	}
+	if (best.IsHit()) {
+		best.point = ray.GetPoint(best.distance);
+	}
+	return best;
+}
+
+void Picking::PickObject(GraphicsObject& object, const Ray& ray, PickResult& best)
+{
+	float distance;
+	if (!object.GetSubtreeBox().Intersects(ray, best.distance, distance)) {
+		return;
+	}
+	if (object.GetVertexBuffer() != nullptr &&
+		PickMesh(*object.GetVertexBuffer(), object.GetReferenceFrame(),
+			object.GetWorldBox(), ray, best)) {
+		best.object = &object;
+	}
+	for (const auto& child : object.GetChildren()) {
+		PickObject(*child, ray, best);
+	}
+}
+
+bool Picking::PickMesh(
+	VertexBuffer& buffer, const glm::mat4& world, const BoundingBox& worldBox,
+	const Ray& ray, PickResult& best)
+{
+	float distance;
+	if (worldBox.IsEmpty() || !worldBox.Intersects(ray, best.distance, distance)) {
+		return false;
+	}
+	const MeshBvh* bvh = buffer.GetTriangleBvh();
+	if (bvh == nullptr && buffer.GetPrimitiveType() == GL_TRIANGLES) {
+		// The vertices were discarded; only the GpuPicker can pick it
+		return false;
+	}
+	if (bvh == nullptr) {
+		// Lines and points have no area to hit, so their box stands in
+		best.distance = distance;
+		best.primitive = PickResult::noPrimitive;
+		return true;
+	}
+	if (glm::determinant(world) == 0.0f) {
+		return false;
+	}
+	// The direction is not normalized, so distances along the local ray
+	// are world distances
+	glm::mat4 inverse = glm::inverse(world);
+	Ray localRay = {
+		glm::vec3(inverse * glm::vec4(ray.origin, 1.0f)),
+		glm::vec3(inverse * glm::vec4(ray.direction, 0.0f))
+	};
+	MeshHit hit;
+	if (!bvh->Raycast(localRay, best.distance, hit)) {
+		return false;
+	}
+	best.distance = hit.distance;
+	best.primitive = hit.primitive;
+	return true;
+}
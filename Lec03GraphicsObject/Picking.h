@@ -0,0 +1,53 @@
+#pragma once
+#include <limits>
+#include <glm/glm.hpp>
+#include "Bounds.h"
+#include "ComponentPool.h"
+#include "GraphicsObject.h"
+#include "Scene.h"
+
+// What a pick hit: an object at any depth or an entity, the other null
+struct PickResult {
+	// For meshes without triangles, which are hit on their box
+	static constexpr unsigned int noPrimitive = 0xFFFFFFFF;
+
+	GraphicsObject* object;
+	Entity entity;
+	// The triangle's index in draw order, as gl_PrimitiveID counts
+	unsigned int primitive;
+	// Along the ray, in world units, and the world point there
+	float distance;
+	glm::vec3 point;
+
+	inline bool IsHit() const { return object != nullptr || !entity.IsNull(); }
+};
+
+// Finds what is under the cursor on the CPU: the scene's indices give the
+// objects and entities whose boxes the ray enters, nearest first, and
+// their meshes' triangle BVHs give the exact hit. Candidates farther than
+// the best hit so far are never opened, so a pick costs a few tree walks
+// whatever the scene's size. Triangle meshes whose vertices were
+// discarded before their BVH could be rebuilt are never hit here; use
+// GpuPicker for those.
+class Picking
+{
+public:
+	// The ray through a cursor position in window coordinates (y down),
+	// from the near to the far plane of the projection
+	static Ray ScreenToRay(
+		double cursorX, double cursorY, int width, int height,
+		const glm::mat4& view, const glm::mat4& projection);
+	// The closest hit within maxDistance, as of the indices' last update
+	static PickResult Pick(
+		Scene& scene, const Ray& ray,
+		float maxDistance = std::numeric_limits<float>::max());
+
+private:
+	// Tests the object, then its children whose subtree boxes the ray
+	// enters closer than the best hit
+	static void PickObject(GraphicsObject& object, const Ray& ray, PickResult& best);
+	// Tests the mesh in its local space; returns true if it beat the best
+	static bool PickMesh(
+		VertexBuffer& buffer, const glm::mat4& world, const BoundingBox& worldBox,
+		const Ray& ray, PickResult& best);
+};
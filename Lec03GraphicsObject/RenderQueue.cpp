@@ -0,0 +1,74 @@
+#include "RenderQueue.h"
+#include <cstring>
+#include <glad/glad.h>
+
+std::uint64_t RenderQueue::MakeKey(
+	unsigned int pass, unsigned int shaderProgram, unsigned int vertexArray,
+	int primitiveType, float viewDepth)
+{
+	// Positive floats compare like their bit patterns, keep the top 28
+	if (!(viewDepth > 0.0f)) {
+		viewDepth = 0.0f;
+	}
+	std::uint32_t depthBits;
+	std::memcpy(&depthBits, &viewDepth, sizeof(depthBits));
+	std::uint64_t depth = depthBits >> 4;
+
+	// GL primitive enums are 0 (GL_POINTS) to 14 (GL_PATCHES)
+	std::uint64_t primitive = static_cast<std::uint64_t>(primitiveType) & 0xF;
+
+	return
+		(static_cast<std::uint64_t>(pass & 0xF) << 60) |
+		(static_cast<std::uint64_t>(shaderProgram & 0xFFF) << 48) |
+		(static_cast<std::uint64_t>(vertexArray & 0xFFFF) << 32) |
+		(primitive << 28) |
+		depth;
+}
+
+void RenderQueue::Clear()
+{
+	entries.clear();
+	items.clear();
+}
+
+void RenderQueue::Add(std::uint64_t key, const RenderItem& item)
+{
+	entries.push_back({ key, static_cast<std::uint32_t>(items.size()) });
+	items.push_back(item);
+}
+
+void RenderQueue::Append(const RenderQueue& other)
+{
+	std::uint32_t firstItem = static_cast<std::uint32_t>(items.size());
+	items.insert(items.end(), other.items.begin(), other.items.end());
+	entries.reserve(entries.size() + other.entries.size());
+	for (const Entry& entry : other.entries) {
+		entries.push_back({ entry.key, firstItem + entry.item });
+	}
+}
+
+void RenderQueue::Sort()
+{
+	scratch.resize(entries.size());
+	for (int shift = 0; shift < 64; shift += 8) {
+		std::size_t counts[256] = {};
+		for (const Entry& entry : entries) {
+			counts[(entry.key >> shift) & 0xFF]++;
+		}
+		if (counts[(entries.empty() ? 0 : entries[0].key >> shift) & 0xFF] 
+			== entries.size()) {
+			// Every key has the same byte here, the order would not change
+			continue;
+		}
+		std::size_t offset = 0;
+		for (std::size_t& count : counts) {
+			std::size_t start = offset;
+			offset += count;
+			count = start;
+		}
+		for (const Entry& entry : entries) {
+			scratch[counts[(entry.key >> shift) & 0xFF]++] = entry;
+		}
+		entries.swap(scratch);
+	}
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+class VertexBuffer;
+
+// One draw: an object's or entity's mesh and world matrix
+struct RenderItem {
+	VertexBuffer* buffer;
+	glm::mat4 world;
+};
+
+// The draws of one frame, sorted by a 64-bit key so that draws sharing
+// GL state end up next to each other. Key layout, high to low bits:
+//   pass (4) | shader program (12) | vertex array (16) | primitive (4) | depth (28)
+// A vertex array stands for a buffer and its layout (or an arena block).
+// Depth is nearest first; the renderer depth tests, so the order only
+// decides between draws at equal depth.
+class RenderQueue
+{
+private:
+	struct Entry {
+		std::uint64_t key;
+		std::uint32_t item;
+	};
+	std::vector<Entry> entries;
+	std::vector<Entry> scratch;
+	std::vector<RenderItem> items;
+
+public:
+	static std::uint64_t MakeKey(
+		unsigned int pass, unsigned int shaderProgram, unsigned int vertexArray,
+		int primitiveType, float viewDepth);
+
+	inline std::size_t GetSize() const { return entries.size(); }
+	// The i-th item in sorted order
+	inline const RenderItem& GetItem(std::size_t i) const { 
+		return items[entries[i].item]; 
+	}
+
+	void Clear();
+	void Add(std::uint64_t key, const RenderItem& item);
+	// Adds every item of another queue, e.g. one filled on another thread
+	void Append(const RenderQueue& other);
+	// LSD radix sort, 8 bits per pass; passes where every key has the
+	// same byte are skipped
+	void Sort();
+};
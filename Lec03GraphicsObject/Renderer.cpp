@@ -1,74 +1,473 @@
-#include "Shader.h"
+#include "Renderer.h"
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <iostream>
+#include <algorithm>
 #include <vector>
-#include "GraphicsObject.h"
-#include "Scene.h"
+#include <cstring>
+#include "EntitySystems.h"
+#include "GLState.h"
+#include "FrameInvalidation.h"
 
-class Renderer {
-private:
-    std::shared_ptr<Shader> shader;
-    GLuint vaoId;
+Renderer::Renderer(const std::shared_ptr<Shader>& shader, std::size_t numberOfThreads) : 
+    shader(shader), workers(numberOfThreads), stats(), frame(),
+    frameUniforms(sizeof(FrameUniforms))
+{
+    frame.view = glm::mat4(1.0f);
+    frame.projection = glm::mat4(1.0f);
+    isInstanced = false;
+    instanceVboId = 0;
+    useMultiDrawIndirect = false;
+    indirectBufferId = 0;
+}
 
-    void RenderObject(const GraphicsObject& object)
-    {
-        shader->SendMat4Uniform("world", object.GetReferenceFrame());
+Renderer::~Renderer()
+{
+    if (instanceVboId != 0) {
+        GLState::DeleteBuffers(1, &instanceVboId);
+    }
+    if (indirectBufferId != 0) {
+        GLState::DeleteBuffers(1, &indirectBufferId);
+    }
+}
+
+void Renderer::SetProjection(const glm::mat4& projection)
+{
+    if (frame.projection != projection) {
+        frame.projection = projection;
+        FrameInvalidation::Invalidate();
+    }
+}
+
+void Renderer::SetViewport(int width, int height)
+{
+    glm::vec4 viewport(0.0f, 0.0f, width, height);
+    if (frame.viewport != viewport) {
+        frame.viewport = viewport;
+        FrameInvalidation::Invalidate();
+    }
+}
+
+void Renderer::allocateVertexBuffers(const std::vector<std::shared_ptr<GraphicsObject>>& objects)
+{
+    // static allocation of vertex buffers, each buffer records its own VAO
+    for (const auto& object : objects) {
+        object->StaticAllocateVertexBuffer();
+    }
+}
+
+void Renderer::RenderScene(const std::shared_ptr<Scene> scene, const glm::mat4& view)
+{
+    stats = {};
+    if (shader->IsCreated()) {
+        // Send this frame's vertex edits before any draw reads them
+        for (auto& object : scene->GetObjects()) {
+            object->UploadDirtyVertexBuffer();
+        }
+        for (auto& mesh : scene->GetMeshes()) {
+            if (mesh->IsDirty()) {
+                mesh->Select();
+                mesh->UploadDirtyRanges();
+                mesh->Deselect();
+            }
+            mesh->RefreshBounds();
+        }
+        EntitySystems::UpdateTransforms(scene->GetRegistry());
+        EntitySystems::UpdateBounds(scene->GetRegistry());
+
+        // Collect the draws and order them by state
+        Frustum frustum(frame.projection * view);
+        RecordCommands(*scene, view, frustum);
+
+        // Shaders that take instanceWorld at the instance location draw
+        // every run of objects sharing a buffer in a single call
+        isInstanced = glGetAttribLocation(
+            shader->GetShaderProgram(), "instanceWorld") ==
+            static_cast<int>(InstanceLayout::firstLocation);
 
-        auto& buffer = object.GetVertexBuffer();
-        buffer->Select();
-        buffer->SetUpAttributeInterpretration();
-        glDrawArrays(buffer->GetPrimitiveType(), 0, buffer->GetNumberOfVertices());
+        UploadFrameUniforms(view);
+        // One program for the whole queue; the cache may already have it
+        if (GLState::UseProgram(shader->GetShaderProgram())) {
+            stats.programSwitches++;
+        }
+        // The queue is in state order, not scene order, so depth decides
+        // what ends up in front. Equal depths go to the later draw in key
+        // order; nearest first lets the depth test reject hidden fragments
+        GLState::Enable(GL_DEPTH_TEST);
+        GLState::DepthFunc(GL_LEQUAL);
+        if (isInstanced && useMultiDrawIndirect) {
+            DrawQueueIndirect();
+        }
+        else if (isInstanced) {
+            DrawQueueInstanced();
+        }
+        else {
+            DrawQueue();
+        }
 
-        // Recursively render the children
-        auto& children = object.GetChildren();
+        GLState::Disable(GL_DEPTH_TEST);
+        if (GLState::UseProgram(0)) {
+            stats.programSwitches++;
+        }
+        GLState::BindVertexArray(0);
+    }
+}
+
+void Renderer::RecordCommands(
+    Scene& scene, const glm::mat4& view, const Frustum& frustum)
+{
+    EntityRegistry& registry = scene.GetRegistry();
+    scene.UpdateSpatialIndex(workers);
+
+    // Only last frame's visible entities can have the flag set; some may
+    // have been destroyed since
+    for (Entity entity : visible.entities) {
+        VisibilityComponent* visibility = registry.GetVisibilities().Find(entity);
+        if (visibility != nullptr) {
+            visibility->isVisible = false;
+        }
+    }
+    visible.Clear();
+    scene.Query(frustum, visible);
+    stats.culled += static_cast<unsigned int>(
+        scene.GetObjects().size() - visible.objects.size() +
+        registry.GetMeshes().GetSize() - visible.entities.size());
+    const std::vector<GraphicsObject*>& objects = visible.objects;
+    std::size_t numberOfEntities = visible.entities.size();
+
+    // Below this many roots or entities per list, a thread costs more than
+    // it saves; an entity is much less work than a root and its subtree
+    const std::size_t minimumRootsPerList = 1024;
+    const std::size_t minimumEntitiesPerList = 8192;
+    std::size_t numberOfObjectLists = GetNumberOfLists(objects.size(), minimumRootsPerList);
+    std::size_t numberOfEntityLists = 
+        GetNumberOfLists(numberOfEntities, minimumEntitiesPerList);
+    std::size_t numberOfLists = std::max(numberOfObjectLists, numberOfEntityLists);
+    if (commandLists.size() < numberOfLists) {
+        commandLists.resize(numberOfLists);
+    }
+    for (std::size_t i = 0; i < numberOfLists; i++) {
+        commandLists[i].queue.Clear();
+        commandLists[i].culled = 0;
+    }
+
+    workers.ParallelFor(numberOfObjectLists, [&](std::size_t i) {
+        CommandList& list = commandLists[i];
+        std::size_t first = objects.size() * i / numberOfObjectLists;
+        std::size_t last = objects.size() * (i + 1) / numberOfObjectLists;
+        for (std::size_t j = first; j < last; j++) {
+            QueueObject(*objects[j], view, frustum, list);
+        }
+    });
+    workers.ParallelFor(numberOfEntityLists, [&](std::size_t i) {
+        std::size_t first = numberOfEntities * i / numberOfEntityLists;
+        std::size_t last = numberOfEntities * (i + 1) / numberOfEntityLists;
+        QueueEntities(registry, first, last, view, frustum, commandLists[i]);
+    });
+
+    queue.Clear();
+    for (std::size_t i = 0; i < numberOfLists; i++) {
+        queue.Append(commandLists[i].queue);
+        stats.culled += commandLists[i].culled;
+    }
+    queue.Sort();
+}
+
+std::size_t Renderer::GetNumberOfLists(
+    std::size_t count, std::size_t minimumPerList) const
+{
+    std::size_t numberOfLists = std::min(
+        workers.GetNumberOfThreads() + 1,
+        (count + minimumPerList - 1) / minimumPerList);
+    return std::max<std::size_t>(numberOfLists, 1);
+}
+
+void Renderer::QueueObject(
+    const GraphicsObject& object, const glm::mat4& view,
+    const Frustum& frustum, CommandList& list) const
+{
+    // Nothing below an object is drawn when its whole subtree is outside
+    if (!frustum.Intersects(object.GetSubtreeBox())) {
+        list.culled++;
+        return;
+    }
+    auto& children = object.GetChildren();
+    auto& buffer = object.GetVertexBuffer();
+    // A node without a buffer has nothing to draw, only children
+    if (buffer == nullptr) {
         for (auto& child : children) {
-            RenderObject(*child);
+            QueueObject(*child, view, frustum, list);
         }
+        return;
     }
+    if (!frustum.Intersects(object.GetWorldSphere()) ||
+        !frustum.Intersects(object.GetWorldBox())) {
+        list.culled++;
+        for (auto& child : children) {
+            QueueObject(*child, view, frustum, list);
+        }
+        return;
+    }
+
+    RenderItem item = { buffer.get(), object.GetReferenceFrame() };
+    float viewDepth = -(view * item.world[3]).z;
+    list.queue.Add(
+        RenderQueue::MakeKey(
+            0, shader->GetShaderProgram(), buffer->GetVertexArrayId(),
+            buffer->GetPrimitiveType(), viewDepth),
+        item);
 
-public:
-    Renderer(const std::shared_ptr<Shader>& shader) : shader(shader) {
-        // Generate VAO
-        glGenVertexArrays(1, &vaoId);
+    for (auto& child : children) {
+        QueueObject(*child, view, frustum, list);
     }
+}
 
-    ~Renderer() {
-        glDeleteVertexArrays(1, &vaoId);
+void Renderer::QueueEntities(
+    EntityRegistry& registry, std::size_t first, std::size_t last,
+    const glm::mat4& view, const Frustum& frustum, CommandList& list) const
+{
+    // The drawable pools are in the same order, so one lookup finds the
+    // entity in all four; the transforms are in depth order instead
+    const auto& meshes = registry.GetMeshes().GetComponents();
+    const auto& materials = registry.GetMaterials().GetComponents();
+    const auto& bounds = registry.GetBounds().GetComponents();
+    auto& visibilities = registry.GetVisibilities().GetComponents();
+    auto& transforms = registry.GetTransforms();
+    // Each entity is in one range only, so writing its visibility is safe
+    for (std::size_t i = first; i < last; i++) {
+        Entity entity = visible.entities[i];
+        std::uint32_t position = registry.GetDrawablePosition(entity);
+        VisibilityComponent& visibility = visibilities[position];
+        if (visibility.isHidden) {
+            continue;
+        }
+        // The index has tested the box already
+        if (!frustum.Intersects(bounds[position].worldSphere)) {
+            list.culled++;
+            continue;
+        }
+        visibility.isVisible = true;
+
+        unsigned int pass = materials[position].pass;
+        VertexBuffer* buffer = meshes[position].buffer;
+        RenderItem item = { buffer, transforms.Get(entity).world };
+        float viewDepth = -(view * item.world[3]).z;
+        list.queue.Add(
+            RenderQueue::MakeKey(
+                pass, shader->GetShaderProgram(), buffer->GetVertexArrayId(),
+                buffer->GetPrimitiveType(), viewDepth),
+            item);
+    }
+}
+
+void Renderer::DrawQueue()
+{
+    // Every world matrix goes up in one upload before the first draw
+    objectOffsets.clear();
+    objectUniforms.Begin(sizeof(ObjectUniforms), queue.GetSize());
+    for (std::size_t i = 0; i < queue.GetSize(); i++) {
+        ObjectUniforms object = { queue.GetItem(i).world };
+        objectOffsets.push_back(objectUniforms.Push(&object, sizeof(object)));
     }
+    objectUniforms.End();
 
-    void allocateVertexBuffers(const std::vector<std::shared_ptr<GraphicsObject>>& objects) {
-        // Bind VAO before allocating vertex buffers
-        glBindVertexArray(vaoId);
+    unsigned int boundVertexArray = 0;
+    unsigned int boundBuffer = 0;
+    for (std::size_t i = 0; i < queue.GetSize(); i++) {
+        const RenderItem& item = queue.GetItem(i);
+        objectUniforms.BindRange(
+            UniformBindings::object, objectOffsets[i], sizeof(ObjectUniforms));
 
-        // static allocation of vertex buffers
-        for (const auto& object : objects) {
-            object->StaticAllocateVertexBuffer();
+        // The attribute setup was recorded into the VAO at allocation time
+        VertexBuffer* buffer = item.buffer;
+        if (buffer->GetVertexArrayId() != boundVertexArray) {
+            buffer->SelectVertexArray();
+            boundVertexArray = buffer->GetVertexArrayId();
+            stats.vertexArraySwitches++;
+        }
+        if (buffer->GetBufferId() != boundBuffer) {
+            boundBuffer = buffer->GetBufferId();
+            stats.bufferSwitches++;
+        }
+        if (buffer->IsIndexed()) {
+            auto& indexBuffer = buffer->GetIndexBuffer();
+            glDrawElementsBaseVertex(
+                buffer->GetPrimitiveType(), indexBuffer->GetNumberOfIndices(),
+                indexBuffer->GetIndexType(), nullptr, buffer->GetFirstVertex());
+        }
+        else {
+            glDrawArrays(
+                buffer->GetPrimitiveType(), buffer->GetFirstVertex(), 
+                buffer->GetNumberOfVertices());
+        }
+        stats.draws++;
+        stats.instances++;
+    }
+}
+
+void Renderer::DrawQueueInstanced()
+{
+    UploadInstanceWorlds();
+    unsigned int boundVertexArray = 0;
+    unsigned int boundBuffer = 0;
+    std::size_t first = 0;
+    while (first < queue.GetSize()) {
+        // The queue is sorted by VAO, so objects sharing a buffer are adjacent
+        VertexBuffer* buffer = queue.GetItem(first).buffer;
+        std::size_t last = first + 1;
+        while (last < queue.GetSize() && queue.GetItem(last).buffer == buffer) {
+            last++;
+        }
+        GLsizei instanceCount = static_cast<GLsizei>(last - first);
+        GLuint baseInstance = static_cast<GLuint>(first);
+
+        if (buffer->GetVertexArrayId() != boundVertexArray) {
+            buffer->SelectVertexArray();
+            buffer->AttachInstanceBuffer(instanceVboId);
+            boundVertexArray = buffer->GetVertexArrayId();
+            stats.vertexArraySwitches++;
+        }
+        if (buffer->GetBufferId() != boundBuffer) {
+            boundBuffer = buffer->GetBufferId();
+            stats.bufferSwitches++;
         }
+        // The base instance offsets the fetch of instanceWorld to this run
+        if (buffer->IsIndexed()) {
+            auto& indexBuffer = buffer->GetIndexBuffer();
+            glDrawElementsInstancedBaseVertexBaseInstance(
+                buffer->GetPrimitiveType(), indexBuffer->GetNumberOfIndices(),
+                indexBuffer->GetIndexType(), nullptr, instanceCount,
+                buffer->GetFirstVertex(), baseInstance);
+        }
+        else {
+            glDrawArraysInstancedBaseInstance(
+                buffer->GetPrimitiveType(), buffer->GetFirstVertex(),
+                buffer->GetNumberOfVertices(), instanceCount, baseInstance);
+        }
+        stats.draws++;
+        stats.instances += instanceCount;
+        first = last;
+    }
+}
 
-        // Unbind VAO after allocating vertex buffers
-        glBindVertexArray(0);
+void Renderer::UploadInstanceWorlds()
+{
+    instanceWorlds.clear();
+    instanceWorlds.reserve(queue.GetSize());
+    for (std::size_t i = 0; i < queue.GetSize(); i++) {
+        instanceWorlds.push_back(queue.GetItem(i).world);
     }
+    if (instanceVboId == 0) {
+        glGenBuffers(1, &instanceVboId);
+    }
+    // Respecifying the store each frame lets the driver orphan the old one
+    // instead of waiting for last frame's draws to finish reading it
+    GLState::BindBuffer(GL_ARRAY_BUFFER, instanceVboId);
+    glBufferData(
+        GL_ARRAY_BUFFER, instanceWorlds.size() * sizeof(glm::mat4),
+        instanceWorlds.data(), GL_STREAM_DRAW);
+    GLState::BindBuffer(GL_ARRAY_BUFFER, 0);
+}
 
-    void RenderScene(const std::shared_ptr<Scene> scene, const glm::mat4& view) {
-        if (shader->IsCreated()) {
-            glUseProgram(shader->GetShaderProgram());
-            glBindVertexArray(vaoId);
-            shader->SendMat4Uniform("view", view);
+void Renderer::DrawQueueIndirect()
+{
+    UploadInstanceWorlds();
 
-            // Get the objects from the scene
-            const std::vector<std::shared_ptr<GraphicsObject>>& objects = scene->GetObjects();
+    // A batch is a run of queue items whose commands one call can submit
+    struct Batch {
+        VertexBuffer* buffer;
+        std::size_t offset;
+        GLsizei numberOfCommands;
+    };
+    std::vector<Batch> batches;
+    indirectCommands.clear();
+    std::size_t first = 0;
+    while (first < queue.GetSize()) {
+        VertexBuffer* buffer = queue.GetItem(first).buffer;
+        std::size_t last = first + 1;
+        while (last < queue.GetSize() && queue.GetItem(last).buffer == buffer) {
+            last++;
+        }
 
-            // Render the objects in the scene
-            for (auto& object : objects) {
-                RenderObject(*object);
-            }
+        // Buffers placed in one arena share the VAO, so their draws batch
+        // as long as the primitive type matches
+        if (batches.empty() ||
+            batches.back().buffer->GetVertexArrayId() != buffer->GetVertexArrayId() ||
+            batches.back().buffer->GetPrimitiveType() != buffer->GetPrimitiveType() ||
+            batches.back().buffer->IsIndexed() != buffer->IsIndexed()) {
+            batches.push_back({ buffer, indirectCommands.size(), 0 });
+        }
+        batches.back().numberOfCommands++;
 
-            glDisableVertexAttribArray(0);
-            glDisableVertexAttribArray(1);
-            glUseProgram(0);
-            glBindVertexArray(0);
+        // The base instance selects this run's world matrices
+        GLuint instanceCount = static_cast<GLuint>(last - first);
+        GLuint baseInstance = static_cast<GLuint>(first);
+        std::size_t offset = indirectCommands.size();
+        if (buffer->IsIndexed()) {
+            DrawElementsIndirectCommand command = {
+                buffer->GetIndexBuffer()->GetNumberOfIndices(), instanceCount,
+                0, static_cast<GLint>(buffer->GetFirstVertex()), baseInstance };
+            indirectCommands.resize(offset + sizeof(command));
+            std::memcpy(&indirectCommands[offset], &command, sizeof(command));
+        }
+        else {
+            DrawArraysIndirectCommand command = {
+                buffer->GetNumberOfVertices(), instanceCount,
+                buffer->GetFirstVertex(), baseInstance };
+            indirectCommands.resize(offset + sizeof(command));
+            std::memcpy(&indirectCommands[offset], &command, sizeof(command));
+        }
+        stats.instances += instanceCount;
+        first = last;
+    }
+    if (batches.empty()) {
+        return;
+    }
+
+    if (indirectBufferId == 0) {
+        glGenBuffers(1, &indirectBufferId);
+    }
+    GLState::BindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBufferId);
+    glBufferData(
+        GL_DRAW_INDIRECT_BUFFER, indirectCommands.size(),
+        indirectCommands.data(), GL_STREAM_DRAW);
+
+    unsigned int boundVertexArray = 0;
+    unsigned int boundBuffer = 0;
+    for (auto& batch : batches) {
+        // Batches split by primitive or index setup alone keep the VAO
+        if (batch.buffer->GetVertexArrayId() != boundVertexArray) {
+            batch.buffer->SelectVertexArray();
+            batch.buffer->AttachInstanceBuffer(instanceVboId);
+            boundVertexArray = batch.buffer->GetVertexArrayId();
+            stats.vertexArraySwitches++;
+        }
+        if (batch.buffer->GetBufferId() != boundBuffer) {
+            boundBuffer = batch.buffer->GetBufferId();
+            stats.bufferSwitches++;
+        }
+        const void* offset = reinterpret_cast<const void*>(batch.offset);
+        if (batch.buffer->IsIndexed()) {
+            glMultiDrawElementsIndirect(
+                batch.buffer->GetPrimitiveType(),
+                batch.buffer->GetIndexBuffer()->GetIndexType(),
+                offset, batch.numberOfCommands, 0);
+        }
+        else {
+            glMultiDrawArraysIndirect(
+                batch.buffer->GetPrimitiveType(), offset,
+                batch.numberOfCommands, 0);
         }
+        stats.draws++;
     }
-};
+    GLState::BindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
 
+void Renderer::UploadFrameUniforms(const glm::mat4& view)
+{
+    frame.view = view;
+    frame.time = static_cast<float>(glfwGetTime());
+    frameUniforms.Upload(&frame, sizeof(frame));
+    // The binding is context state, so it holds across program switches
+    frameUniforms.BindBase(UniformBindings::frame);
+}
@@ -2,22 +2,129 @@
 #include <string>
 #include <sstream>
 #include <unordered_map>
+#include <vector>
 #include <glm/glm.hpp>
 #include "BaseObject.h"
 #include <glad/glad.h>
+#include "EntityRegistry.h"
 #include "GraphicsObject.h"
+#include "RenderQueue.h"
 #include "Scene.h"
 #include "Shader.h"
+#include "UniformBuffer.h"
+#include "WorkerPool.h"
+
+// State changes and draws issued by the last RenderScene
+struct RenderStats {
+    unsigned int draws;
+    unsigned int instances;
+    // Objects, whole subtrees or entities whose bounds were outside the
+    // view volume
+    unsigned int culled;
+    // glUseProgram calls GLState let through, including the unbind at the end
+    unsigned int programSwitches;
+    unsigned int vertexArraySwitches;
+    unsigned int bufferSwitches;
+};
+
+// Layouts glMultiDrawArraysIndirect and glMultiDrawElementsIndirect read
+struct DrawArraysIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint first;
+    GLuint baseInstance;
+};
+
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+// The draws one recording thread found, merged into the frame's queue on
+// the GL thread. Aligned so threads filling neighbours do not share lines.
+struct alignas(64) CommandList {
+    RenderQueue queue;
+    unsigned int culled;
+};
+
 class Renderer {
 private:
     std::shared_ptr<Shader> shader;
-    GLuint vaoId;
+    RenderQueue queue;
+    // Scene traversal and culling run on these threads, GL calls do not
+    WorkerPool workers;
+    std::vector<CommandList> commandLists;
+    // What the spatial indices found in the view volume this frame
+    SceneQueryResult visible;
+    RenderStats stats;
+    // Shared constants, sent once per frame whatever the shader
+    FrameUniforms frame;
+    UniformBuffer frameUniforms;
+    // One ObjectUniforms block per object drawn on the per-object path
+    UniformRing objectUniforms;
+    std::vector<std::size_t> objectOffsets;
+    // Per-instance world matrices, used when the shader reads instanceWorld
+    bool isInstanced;
+    unsigned int instanceVboId;
+    std::vector<glm::mat4> instanceWorlds;
+    // Draw parameters for the multi-draw indirect path
+    bool useMultiDrawIndirect;
+    unsigned int indirectBufferId;
+    std::vector<unsigned char> indirectCommands;
 
 public:
-    Renderer(std::shared_ptr<Shader>& shader);
+    Renderer(
+        const std::shared_ptr<Shader>& shader,
+        std::size_t numberOfThreads = WorkerPool::DefaultNumberOfThreads());
+    ~Renderer();
 
     inline const std::shared_ptr<Shader>& getShader() const {
         return shader;
     }
-};
+    // A shader with instanceWorld at the instance location takes the
+    // instanced paths, one with ObjectUniforms the per-object one
+    inline void SetShader(const std::shared_ptr<Shader>& shader) {
+        this->shader = shader;
+    }
+    inline const RenderStats& GetStats() const { return stats; }
+    inline bool IsInstanced() const { return isInstanced; }
+    inline std::size_t GetNumberOfThreads() const { return workers.GetNumberOfThreads(); }
+    void SetProjection(const glm::mat4& projection);
+    void SetViewport(int width, int height);
+    inline bool IsMultiDrawIndirect() const { return useMultiDrawIndirect; }
+    // Needs an instanced shader, otherwise objects are drawn one by one
+    inline void SetMultiDrawIndirect(bool use) { useMultiDrawIndirect = use; }
 
+    void allocateVertexBuffers(const std::vector<std::shared_ptr<GraphicsObject>>& objects);
+    void RenderScene(const std::shared_ptr<Scene> scene, const glm::mat4& view);
+
+private:
+    // Finds the root objects and entities in the view volume through the
+    // scene's spatial indices, splits them between the worker threads,
+    // which cull further and record their draws, then merges and sorts
+    // the lists
+    void RecordCommands(
+        Scene& scene, const glm::mat4& view, const Frustum& frustum);
+    // How many lists to split count items into, at least one
+    std::size_t GetNumberOfLists(std::size_t count, std::size_t minimumPerList) const;
+    // Adds the object and its children to the list, skipping those
+    // outside the frustum
+    void QueueObject(
+        const GraphicsObject& object, const glm::mat4& view, 
+        const Frustum& frustum, CommandList& list) const;
+    // Adds the visible entities at [first, last) to the list, skipping
+    // hidden ones and those whose sphere is outside the frustum
+    void QueueEntities(
+        EntityRegistry& registry, std::size_t first, std::size_t last,
+        const glm::mat4& view, const Frustum& frustum, CommandList& list) const;
+    void DrawQueue();
+    // Draws each run of objects sharing a buffer as one instanced draw
+    void DrawQueueInstanced();
+    // Submits each group of objects sharing a VAO with one indirect call
+    void DrawQueueIndirect();
+    void UploadInstanceWorlds();
+    void UploadFrameUniforms(const glm::mat4& view);
+};
@@ -1,6 +1,114 @@
 #include "Scene.h"
+#include <algorithm>
+#include "FrameInvalidation.h"
 
 void Scene::AddObject(std::shared_ptr<GraphicsObject> object)
 {
 	objects.push_back(object);
+	// Indexed at the next update, once its bounds are known
+	objectProxies.push_back(SpatialIndex::nullNode);
+	areObjectBoundsChanged.push_back(0);
+	FrameInvalidation::Invalidate();
+}
+
+VertexBuffer* Scene::AddMesh(std::shared_ptr<VertexBuffer> mesh)
+{
+	meshes.push_back(mesh);
+	FrameInvalidation::Invalidate();
+	return mesh.get();
+}
+
+void Scene::UpdateSpatialIndex(WorkerPool& workers)
+{
+	// Below this many roots per task, a thread costs more than it saves
+	const std::size_t minimumRootsPerTask = 1024;
+	std::size_t numberOfTasks = std::min(
+		workers.GetNumberOfThreads() + 1,
+		(objects.size() + minimumRootsPerTask - 1) / minimumRootsPerTask);
+	numberOfTasks = std::max<std::size_t>(numberOfTasks, 1);
+	workers.ParallelFor(numberOfTasks, [&](std::size_t i) {
+		std::size_t first = objects.size() * i / numberOfTasks;
+		std::size_t last = objects.size() * (i + 1) / numberOfTasks;
+		for (std::size_t j = first; j < last; j++) {
+			areObjectBoundsChanged[j] = objects[j]->UpdateWorldBounds();
+		}
+	});
+
+	// The tree is not thread-safe, but only moved roots touch it
+	for (std::size_t i = 0; i < objects.size(); i++) {
+		if (areObjectBoundsChanged[i]) {
+			objectProxies[i] = objectIndex.Update(
+				objectProxies[i], objects[i]->GetSubtreeBox(), i);
+		}
+	}
+}
+
+void Scene::Query(const Frustum& frustum, SceneQueryResult& result) const
+{
+	std::vector<std::uint64_t> items;
+	objectIndex.Query(frustum, items);
+	for (std::uint64_t item : items) {
+		result.objects.push_back(objects[item].get());
+	}
+	items.clear();
+	registry.GetSpatialIndex().Query(frustum, items);
+	for (std::uint64_t item : items) {
+		result.entities.push_back(Entity::FromKey(item));
+	}
+}
+
+void Scene::Query(const BoundingBox& region, SceneQueryResult& result) const
+{
+	std::vector<std::uint64_t> items;
+	objectIndex.Query(region, items);
+	for (std::uint64_t item : items) {
+		result.objects.push_back(objects[item].get());
+	}
+	items.clear();
+	registry.GetSpatialIndex().Query(region, items);
+	for (std::uint64_t item : items) {
+		result.entities.push_back(Entity::FromKey(item));
+	}
+}
+
+void Scene::Query(const glm::vec3& point, SceneQueryResult& result) const
+{
+	std::vector<std::uint64_t> items;
+	objectIndex.Query(point, items);
+	for (std::uint64_t item : items) {
+		result.objects.push_back(objects[item].get());
+	}
+	items.clear();
+	registry.GetSpatialIndex().Query(point, items);
+	for (std::uint64_t item : items) {
+		result.entities.push_back(Entity::FromKey(item));
+	}
+}
+
+void Scene::QueryRect(
+	const glm::vec2& min, const glm::vec2& max, SceneQueryResult& result) const
+{
+	BoundingBox region;
+	region.min = glm::vec3(min, std::numeric_limits<float>::lowest());
+	region.max = glm::vec3(max, std::numeric_limits<float>::max());
+	Query(region, result);
+}
+
+SceneNearestResult Scene::FindNearest(const glm::vec3& point, float maxDistance) const
+{
+	SceneNearestResult result = { nullptr, Entity(), maxDistance };
+	std::uint64_t item;
+	float distance;
+	if (objectIndex.FindNearest(point, maxDistance, item, distance)) {
+		result.object = objects[item].get();
+		result.distance = distance;
+	}
+	// Only an entity closer than the object replaces it
+	if (registry.GetSpatialIndex().FindNearest(point, result.distance, item, distance) &&
+		(result.object == nullptr || distance < result.distance)) {
+		result.object = nullptr;
+		result.entity = Entity::FromKey(item);
+		result.distance = distance;
+	}
+	return result;
 }
@@ -1,12 +1,43 @@
 #pragma once
+#include <limits>
 #include <memory>
 #include <vector>
+#include "EntityRegistry.h"
 #include "GraphicsObject.h"
+#include "SpatialIndex.h"
+#include "WorkerPool.h"
+
+// What a query found: root objects whose subtree bounds matched, and
+// entities whose bounds did
+struct SceneQueryResult {
+	std::vector<GraphicsObject*> objects;
+	std::vector<Entity> entities;
+
+	inline void Clear() {
+		objects.clear();
+		entities.clear();
+	}
+};
+
+// The closest root object or entity; the other is null
+struct SceneNearestResult {
+	GraphicsObject* object;
+	Entity entity;
+	float distance;
+};
 
 class Scene
 {
 private:
 	std::vector<std::shared_ptr<GraphicsObject>> objects;
+	// The root objects' subtree boxes; per root, its proxy in the index
+	// and whether its bounds changed in the last update
+	SpatialIndex objectIndex;
+	std::vector<int> objectProxies;
+	std::vector<unsigned char> areObjectBoundsChanged;
+	// Entities, for scenes too large for an object per draw
+	EntityRegistry registry;
+	std::vector<std::shared_ptr<VertexBuffer>> meshes;
 
 public:
 	Scene() = default;
@@ -15,5 +46,31 @@ public:
 		return objects;
 	}
 	void AddObject(std::shared_ptr<GraphicsObject> object);
+	inline const SpatialIndex& GetObjectIndex() const { return objectIndex; }
+	// Brings the root objects' bounds up to date on the workers, then moves
+	// those that changed in the index. Entities are moved by
+	// EntitySystems::UpdateBounds.
+	void UpdateSpatialIndex(WorkerPool& workers);
+
+	// Queries both indices, as of their last update
+	void Query(const Frustum& frustum, SceneQueryResult& result) const;
+	void Query(const BoundingBox& region, SceneQueryResult& result) const;
+	void Query(const glm::vec3& point, SceneQueryResult& result) const;
+	// Everything over the rectangle, at any depth
+	void QueryRect(const glm::vec2& min, const glm::vec2& max, SceneQueryResult& result) const;
+	// The object or entity whose bounds are closest to the point; both
+	// null when none is within maxDistance
+	SceneNearestResult FindNearest(
+		const glm::vec3& point,
+		float maxDistance = std::numeric_limits<float>::max()) const;
+
+	inline EntityRegistry& GetRegistry() { return registry; }
+	inline const EntityRegistry& GetRegistry() const { return registry; }
+	inline const std::vector<std::shared_ptr<VertexBuffer>>& GetMeshes() const {
+		return meshes;
+	}
+	// Keeps the mesh alive for the entities drawing it, and returns what
+	// their MeshComponent holds
+	VertexBuffer* AddMesh(std::shared_ptr<VertexBuffer> mesh);
 };
 
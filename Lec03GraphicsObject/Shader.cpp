@@ -4,6 +4,7 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include "TextFile.h"
+#include "GLState.h"
 
 Shader::Shader(const std::string& vertexSource, const std::string& fragmentSource)
 {
@@ -35,10 +36,16 @@ void Shader::AddUniform(const std::string& uniformName)
 
 void Shader::SendMat4Uniform(const std::string& uniformName, const glm::mat4& mat)
 {
-    glUseProgram(shaderProgram);
+    GLState::UseProgram(shaderProgram);
     glUniformMatrix4fv(uniformMap[uniformName], 1, GL_FALSE, glm::value_ptr(mat));
 }
 
+void Shader::SendUIntUniform(const std::string& uniformName, unsigned int value)
+{
+    GLState::UseProgram(shaderProgram);
+    glUniform1ui(uniformMap[uniformName], value);
+}
+
 void Shader::SetDefaultSource()
 {
     vertexSource =
@@ -46,9 +53,15 @@ void Shader::SetDefaultSource()
         "layout(location = 0) in vec3 position;\n"
         "layout(location = 1) in vec3 color;\n"
         "out vec4 fragColor;\n"
-        "uniform mat4 world;\n"
-        "uniform mat4 view;\n"
-        "uniform mat4 projection;\n"
+        "layout(std140, binding = 0) uniform FrameUniforms {\n"
+        "    mat4 view;\n"
+        "    mat4 projection;\n"
+        "    vec4 viewport;\n"
+        "    float time;\n"
+        "};\n"
+        "layout(std140, binding = 1) uniform ObjectUniforms {\n"
+        "    mat4 world;\n"
+        "};\n"
         "void main()\n"
         "{\n"
         "   gl_Position = projection * view * world * vec4(position, 1.0);\n"
@@ -146,7 +159,7 @@ void Shader::CreateShaderProgram()
         glGetProgramInfoLog(shaderProgram, maxLength, &maxLength, &infoLog[0]);
 
         // We don't need the program anymore.
-        glDeleteProgram(shaderProgram);
+        GLState::DeleteProgram(shaderProgram);
         // Don't leak shaders either.
         glDeleteShader(vertexShader);
         glDeleteShader(fragmentShader);
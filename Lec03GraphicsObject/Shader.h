@@ -25,6 +25,7 @@ public:
 
 	void AddUniform(const std::string& uniformName);
 	void SendMat4Uniform(const std::string& uniformName, const glm::mat4& mat);
+	void SendUIntUniform(const std::string& uniformName, unsigned int value);
 
 private:
 	void SetDefaultSource();
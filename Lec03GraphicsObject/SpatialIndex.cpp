@@ -0,0 +1,430 @@
+#include "SpatialIndex.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <queue>
+#include <utility>
+
+static BoundingBox Union(const BoundingBox& a, const BoundingBox& b)
+{
+	BoundingBox box = a;
+	box.Include(b);
+	return box;
+}
+
+SpatialIndex::SpatialIndex(float margin) : margin(margin)
+{
+	root = nullNode;
+	freeList = nullNode;
+	numberOfItems = 0;
+}
+
+int SpatialIndex::Insert(const BoundingBox& box, std::uint64_t item)
+{
+	if (box.IsEmpty()) {
+		throw "Cannot index an empty box!";
+	}
+	int leaf = AllocateNode();
+	glm::vec3 size = box.max - box.min;
+	glm::vec3 grow(margin * std::max({ size.x, size.y, size.z }));
+	nodes[leaf].fatBox.min = box.min - grow;
+	nodes[leaf].fatBox.max = box.max + grow;
+	nodes[leaf].box = box;
+	nodes[leaf].item = item;
+	InsertLeaf(leaf);
+	numberOfItems++;
+	return leaf;
+}
+
+void SpatialIndex::Remove(int proxy)
+{
+	RemoveLeaf(proxy);
+	FreeNode(proxy);
+	numberOfItems--;
+}
+
+bool SpatialIndex::Move(int proxy, const BoundingBox& box)
+{
+	if (box.IsEmpty()) {
+		throw "Cannot index an empty box!";
+	}
+	nodes[proxy].box = box;
+	if (nodes[proxy].fatBox.Contains(box)) {
+		return false;
+	}
+	RemoveLeaf(proxy);
+	glm::vec3 size = box.max - box.min;
+	glm::vec3 grow(margin * std::max({ size.x, size.y, size.z }));
+	nodes[proxy].fatBox.min = box.min - grow;
+	nodes[proxy].fatBox.max = box.max + grow;
+	InsertLeaf(proxy);
+	return true;
+}
+
+int SpatialIndex::Update(int proxy, const BoundingBox& box, std::uint64_t item)
+{
+	if (box.IsEmpty()) {
+		if (proxy != nullNode) {
+			Remove(proxy);
+		}
+		return nullNode;
+	}
+	if (proxy == nullNode) {
+		return Insert(box, item);
+	}
+	Move(proxy, box);
+	return proxy;
+}
+
+void SpatialIndex::Clear()
+{
+	nodes.clear();
+	root = nullNode;
+	freeList = nullNode;
+	numberOfItems = 0;
+}
+
+void SpatialIndex::Query(const Frustum& frustum, std::vector<std::uint64_t>& items) const
+{
+	if (root == nullNode) {
+		return;
+	}
+	std::vector<int> stack = { root };
+	while (!stack.empty()) {
+		const Node& node = nodes[stack.back()];
+		int index = stack.back();
+		stack.pop_back();
+		if (!frustum.Intersects(node.fatBox)) {
+			continue;
+		}
+		if (node.IsLeaf()) {
+			if (frustum.Intersects(node.box)) {
+				items.push_back(node.item);
+			}
+		}
+		// Everything below a node inside the volume is in it, untested
+		else if (frustum.Contains(node.fatBox)) {
+			CollectItems(index, items);
+		}
+		else {
+			stack.push_back(node.children[0]);
+			stack.push_back(node.children[1]);
+		}
+	}
+}
+
+void SpatialIndex::Query(const BoundingBox& region, std::vector<std::uint64_t>& items) const
+{
+	if (root == nullNode) {
+		return;
+	}
+	std::vector<int> stack = { root };
+	while (!stack.empty()) {
+		const Node& node = nodes[stack.back()];
+		stack.pop_back();
+		if (!node.fatBox.Overlaps(region)) {
+			continue;
+		}
+		if (node.IsLeaf()) {
+			if (node.box.Overlaps(region)) {
+				items.push_back(node.item);
+			}
+		}
+		else {
+			stack.push_back(node.children[0]);
+			stack.push_back(node.children[1]);
+		}
+	}
+}
+
+void SpatialIndex::Query(const glm::vec3& point, std::vector<std::uint64_t>& items) const
+{
+	if (root == nullNode) {
+		return;
+	}
+	std::vector<int> stack = { root };
+	while (!stack.empty()) {
+		const Node& node = nodes[stack.back()];
+		stack.pop_back();
+		if (!node.fatBox.Contains(point)) {
+			continue;
+		}
+		if (node.IsLeaf()) {
+			if (node.box.Contains(point)) {
+				items.push_back(node.item);
+			}
+		}
+		else {
+			stack.push_back(node.children[0]);
+			stack.push_back(node.children[1]);
+		}
+	}
+}
+
+void SpatialIndex::Query(
+	const Ray& ray, float maxDistance, std::vector<SpatialIndexHit>& hits) const
+{
+	if (root == nullNode) {
+		return;
+	}
+	std::size_t firstHit = hits.size();
+	std::vector<int> stack = { root };
+	while (!stack.empty()) {
+		const Node& node = nodes[stack.back()];
+		stack.pop_back();
+		float distance;
+		if (!node.fatBox.Intersects(ray, maxDistance, distance)) {
+			continue;
+		}
+		if (node.IsLeaf()) {
+			if (node.box.Intersects(ray, maxDistance, distance)) {
+				hits.push_back({ distance, node.item });
+			}
+		}
+		else {
+			stack.push_back(node.children[0]);
+			stack.push_back(node.children[1]);
+		}
+	}
+	std::sort(hits.begin() + firstHit, hits.end(),
+		[](const SpatialIndexHit& a, const SpatialIndexHit& b) {
+			return a.distance < b.distance;
+		});
+}
+
+bool SpatialIndex::FindNearest(
+	const glm::vec3& point, float maxDistance,
+	std::uint64_t& item, float& distance) const
+{
+	if (root == nullNode) {
+		return false;
+	}
+	float maxDistanceSquared = maxDistance < std::numeric_limits<float>::max() ?
+		maxDistance * maxDistance : std::numeric_limits<float>::max();
+
+	// Best first: nodes come out closest first, keyed by the distance to
+	// their box, which no item below them can beat. Leaves are keyed by
+	// their item's own box, so the first leaf out is the nearest item.
+	using Candidate = std::pair<float, int>;
+	std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> open;
+	open.push({ nodes[root].IsLeaf() ?
+		nodes[root].box.DistanceSquared(point) :
+		nodes[root].fatBox.DistanceSquared(point), root });
+	while (!open.empty()) {
+		Candidate candidate = open.top();
+		open.pop();
+		if (candidate.first > maxDistanceSquared) {
+			return false;
+		}
+		const Node& node = nodes[candidate.second];
+		if (node.IsLeaf()) {
+			item = node.item;
+			distance = std::sqrt(candidate.first);
+			return true;
+		}
+		for (int child : node.children) {
+			const Node& childNode = nodes[child];
+			float childDistance = childNode.IsLeaf() ?
+				childNode.box.DistanceSquared(point) :
+				childNode.fatBox.DistanceSquared(point);
+			if (childDistance <= maxDistanceSquared) {
+				open.push({ childDistance, child });
+			}
+		}
+	}
+	return false;
+}
+
+int SpatialIndex::AllocateNode()
+{
+	int index;
+	if (freeList != nullNode) {
+		index = freeList;
+		freeList = nodes[index].parent;
+	}
+	else {
+		index = static_cast<int>(nodes.size());
+		nodes.emplace_back();
+	}
+	Node& node = nodes[index];
+	node.fatBox = BoundingBox();
+	node.box = BoundingBox();
+	node.item = 0;
+	node.parent = nullNode;
+	node.children[0] = nullNode;
+	node.children[1] = nullNode;
+	node.height = 0;
+	return index;
+}
+
+void SpatialIndex::FreeNode(int index)
+{
+	nodes[index].parent = freeList;
+	nodes[index].height = -1;
+	freeList = index;
+}
+
+void SpatialIndex::InsertLeaf(int leaf)
+{
+	if (root == nullNode) {
+		root = leaf;
+		nodes[root].parent = nullNode;
+		return;
+	}
+
+	// Walk down while pushing the leaf further costs less than pairing it
+	// with the current node, in added area
+	const BoundingBox leafBox = nodes[leaf].fatBox;
+	int index = root;
+	while (!nodes[index].IsLeaf()) {
+		const Node& node = nodes[index];
+		float area = node.fatBox.GetHalfArea();
+		float combinedArea = Union(node.fatBox, leafBox).GetHalfArea();
+		float pairCost = 2.0f * combinedArea;
+		// Every node above the leaf grows by at least this much
+		float inheritedCost = 2.0f * (combinedArea - area);
+
+		float childCosts[2];
+		for (int i = 0; i < 2; i++) {
+			const Node& child = nodes[node.children[i]];
+			float childArea = Union(child.fatBox, leafBox).GetHalfArea();
+			if (!child.IsLeaf()) {
+				childArea -= child.fatBox.GetHalfArea();
+			}
+			childCosts[i] = childArea + inheritedCost;
+		}
+		if (pairCost < childCosts[0] && pairCost < childCosts[1]) {
+			break;
+		}
+		index = childCosts[0] < childCosts[1] ? node.children[0] : node.children[1];
+	}
+
+	// A new parent takes the sibling's place and holds both
+	int sibling = index;
+	int oldParent = nodes[sibling].parent;
+	int newParent = AllocateNode();
+	nodes[newParent].parent = oldParent;
+	nodes[newParent].fatBox = Union(nodes[sibling].fatBox, leafBox);
+	nodes[newParent].height = nodes[sibling].height + 1;
+	nodes[newParent].children[0] = sibling;
+	nodes[newParent].children[1] = leaf;
+	nodes[sibling].parent = newParent;
+	nodes[leaf].parent = newParent;
+	if (oldParent == nullNode) {
+		root = newParent;
+	}
+	else if (nodes[oldParent].children[0] == sibling) {
+		nodes[oldParent].children[0] = newParent;
+	}
+	else {
+		nodes[oldParent].children[1] = newParent;
+	}
+	Refit(oldParent);
+}
+
+void SpatialIndex::RemoveLeaf(int leaf)
+{
+	if (leaf == root) {
+		root = nullNode;
+		return;
+	}
+	// The sibling takes the parent's place
+	int parent = nodes[leaf].parent;
+	int grandParent = nodes[parent].parent;
+	int sibling = nodes[parent].children[0] == leaf ?
+		nodes[parent].children[1] : nodes[parent].children[0];
+	nodes[sibling].parent = grandParent;
+	if (grandParent == nullNode) {
+		root = sibling;
+	}
+	else if (nodes[grandParent].children[0] == parent) {
+		nodes[grandParent].children[0] = sibling;
+	}
+	else {
+		nodes[grandParent].children[1] = sibling;
+	}
+	FreeNode(parent);
+	nodes[leaf].parent = nullNode;
+	Refit(grandParent);
+}
+
+void SpatialIndex::Refit(int index)
+{
+	while (index != nullNode) {
+		index = Balance(index);
+		Node& node = nodes[index];
+		const Node& child0 = nodes[node.children[0]];
+		const Node& child1 = nodes[node.children[1]];
+		node.height = 1 + std::max(child0.height, child1.height);
+		node.fatBox = Union(child0.fatBox, child1.fatBox);
+		index = node.parent;
+	}
+}
+
+int SpatialIndex::Balance(int indexA)
+{
+	Node& a = nodes[indexA];
+	if (a.IsLeaf() || a.height < 2) {
+		return indexA;
+	}
+	int indexB = a.children[0];
+	int indexC = a.children[1];
+	Node& b = nodes[indexB];
+	Node& c = nodes[indexC];
+	int balance = c.height - b.height;
+	if (balance >= -1 && balance <= 1) {
+		return indexA;
+	}
+
+	// The taller child goes up into a's place, a takes its shorter child
+	int indexUp = balance > 1 ? indexC : indexB;
+	int indexStay = balance > 1 ? indexB : indexC;
+	int sideUp = balance > 1 ? 1 : 0;
+	Node& up = nodes[indexUp];
+	Node& stay = nodes[indexStay];
+	int indexF = up.children[0];
+	int indexG = up.children[1];
+	Node& f = nodes[indexF];
+	Node& g = nodes[indexG];
+
+	up.children[0] = indexA;
+	up.parent = a.parent;
+	a.parent = indexUp;
+	if (up.parent == nullNode) {
+		root = indexUp;
+	}
+	else if (nodes[up.parent].children[0] == indexA) {
+		nodes[up.parent].children[0] = indexUp;
+	}
+	else {
+		nodes[up.parent].children[1] = indexUp;
+	}
+
+	// The taller grandchild stays with the node going up
+	int indexKeep = f.height > g.height ? indexF : indexG;
+	int indexGive = f.height > g.height ? indexG : indexF;
+	up.children[1] = indexKeep;
+	a.children[sideUp] = indexGive;
+	nodes[indexGive].parent = indexA;
+	a.fatBox = Union(stay.fatBox, nodes[indexGive].fatBox);
+	a.height = 1 + std::max(stay.height, nodes[indexGive].height);
+	up.fatBox = Union(a.fatBox, nodes[indexKeep].fatBox);
+	up.height = 1 + std::max(a.height, nodes[indexKeep].height);
+	return indexUp;
+}
+
+void SpatialIndex::CollectItems(int index, std::vector<std::uint64_t>& items) const
+{
+	std::vector<int> stack = { index };
+	while (!stack.empty()) {
+		const Node& node = nodes[stack.back()];
+		stack.pop_back();
+		if (node.IsLeaf()) {
+			items.push_back(node.item);
+		}
+		else {
+			stack.push_back(node.children[0]);
+			stack.push_back(node.children[1]);
+		}
+	}
+}
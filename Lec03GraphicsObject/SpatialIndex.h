@@ -0,0 +1,91 @@
+#pragma once
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Bounds.h"
+
+// An item whose box a ray enters, and how far along the ray
+struct SpatialIndexHit {
+	float distance;
+	std::uint64_t item;
+};
+
+// A dynamic bounding volume hierarchy over the world boxes of items. A
+// leaf keeps its item's box enlarged by a margin, so an item that moves a
+// little stays where it is and only items leaving their leaf box are
+// reinserted. Inserts go next to the node that grows the tree's area
+// least and rotations keep the tree balanced, so updates and queries take
+// O(log n). Queries may run on several threads at once, updates may not.
+class SpatialIndex
+{
+public:
+	static constexpr int nullNode = -1;
+
+private:
+	struct Node {
+		// The leaf's enlarged box, or the union of the children's
+		BoundingBox fatBox;
+		// The item's own box, leaves only
+		BoundingBox box;
+		std::uint64_t item;
+		// The next free node while the node is free
+		int parent;
+		int children[2];
+		// 0 for leaves
+		int height;
+
+		inline bool IsLeaf() const { return children[0] == nullNode; }
+	};
+	std::vector<Node> nodes;
+	int root;
+	int freeList;
+	std::size_t numberOfItems;
+	// Leaves are enlarged by this fraction of their largest side
+	float margin;
+
+public:
+	SpatialIndex(float margin = 0.1f);
+	~SpatialIndex() = default;
+
+	inline std::size_t GetNumberOfItems() const { return numberOfItems; }
+	inline int GetHeight() const { return root == nullNode ? 0 : nodes[root].height; }
+	inline std::uint64_t GetItem(int proxy) const { return nodes[proxy].item; }
+	inline const BoundingBox& GetBox(int proxy) const { return nodes[proxy].box; }
+
+	// Returns the item's proxy; throws if the box is empty
+	int Insert(const BoundingBox& box, std::uint64_t item);
+	void Remove(int proxy);
+	// Changes the item's box; returns true if it had to be reinserted
+	bool Move(int proxy, const BoundingBox& box);
+	// Inserts, moves or (for an empty box) removes the item as needed;
+	// returns the proxy to keep, nullNode when it is not in the index
+	int Update(int proxy, const BoundingBox& box, std::uint64_t item);
+	void Clear();
+
+	// Appends the items whose boxes intersect the volume, region or point
+	void Query(const Frustum& frustum, std::vector<std::uint64_t>& items) const;
+	void Query(const BoundingBox& region, std::vector<std::uint64_t>& items) const;
+	void Query(const glm::vec3& point, std::vector<std::uint64_t>& items) const;
+	// Appends the items whose boxes the ray enters within maxDistance,
+	// nearest first
+	void Query(const Ray& ray, float maxDistance, std::vector<SpatialIndexHit>& hits) const;
+	// The item whose box is closest to the point, 0 away if it contains
+	// it; returns false when none is within maxDistance
+	bool FindNearest(
+		const glm::vec3& point, float maxDistance,
+		std::uint64_t& item, float& distance) const;
+
+private:
+	int AllocateNode();
+	void FreeNode(int index);
+	void InsertLeaf(int leaf);
+	void RemoveLeaf(int leaf);
+	// Refits the boxes and heights from the node up to the root
+	void Refit(int index);
+	// Rotates the grandchild of a node up if its subtrees' heights differ
+	// by more than one; returns the node now in its place
+	int Balance(int index);
+	// Appends every item below the node
+	void CollectItems(int index, std::vector<std::uint64_t>& items) const;
+};
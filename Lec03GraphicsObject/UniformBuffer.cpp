@@ -0,0 +1,102 @@
+#include "UniformBuffer.h"
+#include <cstring>
+
+UniformBuffer::UniformBuffer(std::size_t sizeInBytes)
+{
+	this->sizeInBytes = sizeInBytes;
+	glGenBuffers(1, &uboId);
+	Select();
+	glBufferData(GL_UNIFORM_BUFFER, sizeInBytes, nullptr, GL_DYNAMIC_DRAW);
+	Deselect();
+}
+
+UniformBuffer::~UniformBuffer()
+{
+	GLState::DeleteBuffers(1, &uboId);
+}
+
+void UniformBuffer::Upload(const void* data, std::size_t size, std::size_t offset)
+{
+	if (offset + size > sizeInBytes) {
+		throw "Uniform data does not fit in the buffer!";
+	}
+	Select();
+	glBufferSubData(GL_UNIFORM_BUFFER, offset, size, data);
+	Deselect();
+}
+
+void UniformBuffer::BindBase(unsigned int binding)
+{
+	GLState::BindBufferBase(GL_UNIFORM_BUFFER, binding, uboId);
+}
+
+UniformRing::UniformRing(std::size_t capacity)
+{
+	GLint offsetAlignment = 256;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &offsetAlignment);
+	alignment = offsetAlignment > 0 ? offsetAlignment : 256;
+	this->capacity = capacity;
+	head = 0;
+	frameStart = 0;
+	glGenBuffers(1, &uboId);
+	Orphan();
+}
+
+UniformRing::~UniformRing()
+{
+	GLState::DeleteBuffers(1, &uboId);
+}
+
+void UniformRing::Begin(std::size_t blockSize, std::size_t count)
+{
+	std::size_t needed = Align(blockSize) * count;
+	if (needed > capacity) {
+		while (capacity < needed) {
+			capacity *= 2;
+		}
+		Orphan();
+		head = 0;
+	}
+	else if (head + needed > capacity) {
+		// Draws still reading the old storage keep it until they finish
+		Orphan();
+		head = 0;
+	}
+	frameStart = head;
+	staging.clear();
+}
+
+std::size_t UniformRing::Push(const void* data, std::size_t size)
+{
+	std::size_t offset = head;
+	std::size_t stagingOffset = head - frameStart;
+	staging.resize(stagingOffset + Align(size));
+	std::memcpy(&staging[stagingOffset], data, size);
+	head += Align(size);
+	if (head > capacity) {
+		throw "Uniform ring overflow, Begin reserved too few blocks!";
+	}
+	return offset;
+}
+
+void UniformRing::End()
+{
+	if (staging.empty()) {
+		return;
+	}
+	GLState::BindBuffer(GL_UNIFORM_BUFFER, uboId);
+	glBufferSubData(GL_UNIFORM_BUFFER, frameStart, staging.size(), staging.data());
+	GLState::BindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void UniformRing::BindRange(unsigned int binding, std::size_t offset, std::size_t size)
+{
+	GLState::BindBufferRange(GL_UNIFORM_BUFFER, binding, uboId, offset, size);
+}
+
+void UniformRing::Orphan()
+{
+	GLState::BindBuffer(GL_UNIFORM_BUFFER, uboId);
+	glBufferData(GL_UNIFORM_BUFFER, capacity, nullptr, GL_STREAM_DRAW);
+	GLState::BindBuffer(GL_UNIFORM_BUFFER, 0);
+}
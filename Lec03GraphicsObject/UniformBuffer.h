@@ -0,0 +1,81 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include "GLState.h"
+
+// Binding points shared by the uniform blocks of every shader
+struct UniformBindings {
+	static constexpr unsigned int frame = 0;
+	static constexpr unsigned int object = 1;
+};
+
+// layout(std140, binding = 0) uniform FrameUniforms
+struct FrameUniforms {
+	glm::mat4 view;
+	glm::mat4 projection;
+	// x, y, width, height in pixels
+	glm::vec4 viewport;
+	// Seconds since the window opened
+	float time;
+	float padding[3];
+};
+
+// layout(std140, binding = 1) uniform ObjectUniforms
+struct ObjectUniforms {
+	glm::mat4 world;
+};
+
+class UniformBuffer
+{
+protected:
+	unsigned int uboId;
+	std::size_t sizeInBytes;
+
+public:
+	UniformBuffer(std::size_t sizeInBytes);
+	~UniformBuffer();
+
+	inline void Select() { GLState::BindBuffer(GL_UNIFORM_BUFFER, uboId); }
+	inline void Deselect() { GLState::BindBuffer(GL_UNIFORM_BUFFER, 0); }
+	inline unsigned int GetBufferId() const { return uboId; }
+	inline std::size_t GetSizeInBytes() const { return sizeInBytes; }
+
+	void Upload(const void* data, std::size_t size, std::size_t offset = 0);
+	// Binds the whole buffer to the binding point for every program
+	void BindBase(unsigned int binding);
+};
+
+// Hands out aligned ranges of one uniform buffer, wrapping to the start
+// and orphaning the old storage when the end is reached. A frame pushes
+// all its blocks between Begin and End, which sends them in one upload.
+class UniformRing
+{
+protected:
+	unsigned int uboId;
+	std::size_t capacity;
+	std::size_t alignment;
+	std::size_t head;
+	std::size_t frameStart;
+	std::vector<unsigned char> staging;
+
+public:
+	UniformRing(std::size_t capacity = 1 << 20);
+	~UniformRing();
+
+	inline unsigned int GetBufferId() const { return uboId; }
+	inline std::size_t GetCapacity() const { return capacity; }
+
+	// Makes room for count blocks of blockSize bytes
+	void Begin(std::size_t blockSize, std::size_t count);
+	// Copies the block and returns its offset in the buffer
+	std::size_t Push(const void* data, std::size_t size);
+	void End();
+	void BindRange(unsigned int binding, std::size_t offset, std::size_t size);
+
+protected:
+	inline std::size_t Align(std::size_t size) const {
+		return (size + alignment - 1) / alignment * alignment;
+	}
+	void Orphan();
+};
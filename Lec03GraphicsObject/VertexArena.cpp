@@ -0,0 +1,272 @@
+#include "VertexArena.h"
+#include "VertexBuffer.h"
+#include "GLState.h"
+#include "VertexMemory.h"
+#include <algorithm>
+
+VertexArena::VertexArena(unsigned int vertexSizeInBytes, unsigned int verticesPerBlock)
+{
+	this->vertexSizeInBytes = vertexSizeInBytes;
+	this->verticesPerBlock = verticesPerBlock;
+	setUpLayout = nullptr;
+}
+
+VertexArena::~VertexArena()
+{
+	for (auto& block : blocks) {
+		GLState::DeleteVertexArrays(1, &block.vaoId);
+		GLState::DeleteBuffers(1, &block.vboId);
+	}
+	VertexMemory::AddGpuBytes(
+		-static_cast<long long>(blocks.size()) * verticesPerBlock * vertexSizeInBytes);
+}
+
+unsigned int VertexArena::GetNumberOfFreeVertices() const
+{
+	unsigned int count = 0;
+	for (const auto& block : blocks) {
+		for (const auto& range : block.freeByOffset) {
+			count += range.second;
+		}
+	}
+	return count;
+}
+
+unsigned int VertexArena::GetLargestFreeRange() const
+{
+	unsigned int largest = 0;
+	for (const auto& block : blocks) {
+		if (!block.freeBySize.empty()) {
+			largest = std::max(largest, block.freeBySize.rbegin()->first);
+		}
+	}
+	return largest;
+}
+
+void VertexArena::Place(VertexBuffer& buffer)
+{
+	unsigned int count = buffer.numberOfVertices;
+	if (count > verticesPerBlock) {
+		throw "Mesh is larger than a vertex arena block!";
+	}
+	if (buffer.vertexSizeInBytes != vertexSizeInBytes) {
+		throw "Mesh vertex size does not match the vertex arena!";
+	}
+	if (buffer.isPlacedInArena && buffer.numberOfAllocatedVertices != count) {
+		Release(buffer);
+	}
+	if (count == 0) {
+		// An empty range would share its offset with the next mesh's
+		return;
+	}
+
+	if (!buffer.isPlacedInArena) {
+		unsigned int offset = 0;
+		unsigned int blockIndex = 0;
+		while (blockIndex < blocks.size() && 
+			!TryAllocate(blocks[blockIndex], count, offset)) {
+			blockIndex++;
+		}
+		if (blockIndex == blocks.size()) {
+			blockIndex = CreateBlock();
+			TryAllocate(blocks[blockIndex], count, offset);
+		}
+		Block& block = blocks[blockIndex];
+		block.used[offset] = { count, &buffer };
+		buffer.isPlacedInArena = true;
+		buffer.arenaBlock = blockIndex;
+		buffer.firstVertex = offset;
+		buffer.vboId = block.vboId;
+		buffer.vaoId = block.vaoId;
+	}
+
+	GLState::BindBuffer(GL_ARRAY_BUFFER, buffer.vboId);
+	glBufferSubData(
+		GL_ARRAY_BUFFER, 
+		static_cast<unsigned long long>(buffer.firstVertex) * vertexSizeInBytes,
+		buffer.vertexData.size(), buffer.vertexData.data());
+}
+
+void VertexArena::Release(VertexBuffer& buffer)
+{
+	if (!buffer.isPlacedInArena) {
+		return;
+	}
+	Block& block = blocks[buffer.arenaBlock];
+	auto item = block.used.find(buffer.firstVertex);
+	Free(block, item->first, item->second.first);
+	block.used.erase(item);
+	buffer.isPlacedInArena = false;
+	buffer.vboId = 0;
+	buffer.vaoId = 0;
+	buffer.firstVertex = 0;
+}
+
+void VertexArena::AttachInstanceBuffer(unsigned int blockIndex, unsigned int instanceVboId)
+{
+	Block& block = blocks[blockIndex];
+	if (block.instanceVboId == instanceVboId) {
+		return;
+	}
+	InstanceLayout::SetUp(instanceVboId);
+	block.instanceVboId = instanceVboId;
+}
+
+void VertexArena::Defragment()
+{
+	if (setUpLayout == nullptr) {
+		throw "The vertex arena has no layout!";
+	}
+	for (auto& block : blocks) {
+		if (block.freeByOffset.size() <= 1 && 
+			(block.freeByOffset.empty() || 
+			block.freeByOffset.begin()->first + block.freeByOffset.begin()->second 
+				== verticesPerBlock)) {
+			// Already packed
+			continue;
+		}
+		// Copy into a fresh buffer so source and destination never overlap
+		unsigned int packedVboId;
+		glGenBuffers(1, &packedVboId);
+		GLState::BindBuffer(GL_COPY_WRITE_BUFFER, packedVboId);
+		glBufferData(
+			GL_COPY_WRITE_BUFFER, 
+			static_cast<unsigned long long>(verticesPerBlock) * vertexSizeInBytes,
+			nullptr, GL_STATIC_DRAW);
+		GLState::BindBuffer(GL_COPY_READ_BUFFER, block.vboId);
+
+		std::map<unsigned int, std::pair<unsigned int, VertexBuffer*>> packed;
+		unsigned int nextOffset = 0;
+		for (const auto& [offset, range] : block.used) {
+			auto [count, owner] = range;
+			glCopyBufferSubData(
+				GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+				static_cast<unsigned long long>(offset) * vertexSizeInBytes,
+				static_cast<unsigned long long>(nextOffset) * vertexSizeInBytes,
+				static_cast<unsigned long long>(count) * vertexSizeInBytes);
+			owner->firstVertex = nextOffset;
+			owner->vboId = packedVboId;
+			packed[nextOffset] = range;
+			nextOffset += count;
+		}
+		GLState::BindBuffer(GL_COPY_READ_BUFFER, 0);
+		GLState::BindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		GLState::DeleteBuffers(1, &block.vboId);
+
+		block.vboId = packedVboId;
+		block.used = std::move(packed);
+		block.freeByOffset.clear();
+		block.freeBySize.clear();
+		AddFreeRange(block, nextOffset, verticesPerBlock - nextOffset);
+		RecordVertexArray(block);
+	}
+}
+
+void VertexArena::RecreateAfterContextLoss()
+{
+	std::vector<VertexBuffer*> owners;
+	for (const auto& block : blocks) {
+		for (const auto& [offset, range] : block.used) {
+			VertexBuffer* owner = range.second;
+			if (owner->isVertexDataReleased && owner->compressedData.empty()) {
+				throw "A mesh in the vertex arena discarded its vertices!";
+			}
+			owners.push_back(owner);
+		}
+	}
+	// The old names died with the context, so there is nothing to delete
+	VertexMemory::AddGpuBytes(
+		-static_cast<long long>(blocks.size()) * verticesPerBlock * vertexSizeInBytes);
+	blocks.clear();
+	for (VertexBuffer* owner : owners) {
+		owner->isPlacedInArena = false;
+		owner->StaticAllocate();
+	}
+}
+
+unsigned int VertexArena::CreateBlock()
+{
+	if (setUpLayout == nullptr) {
+		throw "The vertex arena has no layout!";
+	}
+	Block block;
+	glGenBuffers(1, &block.vboId);
+	glGenVertexArrays(1, &block.vaoId);
+	block.instanceVboId = 0;
+	GLState::BindBuffer(GL_ARRAY_BUFFER, block.vboId);
+	glBufferData(
+		GL_ARRAY_BUFFER, 
+		static_cast<unsigned long long>(verticesPerBlock) * vertexSizeInBytes,
+		nullptr, GL_STATIC_DRAW);
+	GLState::BindBuffer(GL_ARRAY_BUFFER, 0);
+	VertexMemory::AddGpuBytes(
+		static_cast<long long>(verticesPerBlock) * vertexSizeInBytes);
+	AddFreeRange(block, 0, verticesPerBlock);
+	RecordVertexArray(block);
+	blocks.push_back(std::move(block));
+	return static_cast<unsigned int>(blocks.size() - 1);
+}
+
+void VertexArena::RecordVertexArray(Block& block)
+{
+	if (setUpLayout == nullptr) {
+		throw "The vertex arena has no layout!";
+	}
+	GLState::BindVertexArray(block.vaoId);
+	GLState::BindBuffer(GL_ARRAY_BUFFER, block.vboId);
+	setUpLayout();
+	GLState::BindVertexArray(0);
+	GLState::BindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void VertexArena::AddFreeRange(Block& block, unsigned int offset, unsigned int count)
+{
+	if (count == 0) {
+		return;
+	}
+	block.freeByOffset[offset] = count;
+	block.freeBySize.insert({ count, offset });
+}
+
+void VertexArena::RemoveFreeRange(Block& block, unsigned int offset, unsigned int count)
+{
+	block.freeByOffset.erase(offset);
+	block.freeBySize.erase({ count, offset });
+}
+
+bool VertexArena::TryAllocate(Block& block, unsigned int count, unsigned int& offset)
+{
+	// Best fit: the smallest free range that holds count vertices
+	auto fit = block.freeBySize.lower_bound({ count, 0 });
+	if (fit == block.freeBySize.end()) {
+		return false;
+	}
+	auto [freeCount, freeOffset] = *fit;
+	RemoveFreeRange(block, freeOffset, freeCount);
+	AddFreeRange(block, freeOffset + count, freeCount - count);
+	offset = freeOffset;
+	return true;
+}
+
+void VertexArena::Free(Block& block, unsigned int offset, unsigned int count)
+{
+	// Coalesce with the free neighbours on both sides
+	auto next = block.freeByOffset.lower_bound(offset);
+	if (next != block.freeByOffset.end() && next->first == offset + count) {
+		unsigned int nextCount = next->second;
+		RemoveFreeRange(block, next->first, nextCount);
+		count += nextCount;
+	}
+	next = block.freeByOffset.lower_bound(offset);
+	if (next != block.freeByOffset.begin()) {
+		auto previous = std::prev(next);
+		if (previous->first + previous->second == offset) {
+			unsigned int previousOffset = previous->first;
+			unsigned int previousCount = previous->second;
+			RemoveFreeRange(block, previousOffset, previousCount);
+			offset = previousOffset;
+			count += previousCount;
+		}
+	}
+	AddFreeRange(block, offset, count);
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <glad/glad.h> 
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+
+class VertexBuffer;
+
+// Holds the vertices of many small meshes in a few large GL buffers. Every
+// mesh gets a range of vertices in one block and is drawn from its first
+// vertex, so meshes in the same block share one buffer and one VAO.
+// All meshes in an arena use the same vertex layout.
+class VertexArena
+{
+protected:
+	struct Block {
+		unsigned int vboId;
+		unsigned int vaoId;
+		// Free ranges by first vertex, and the same ranges by size for
+		// best-fit lookups
+		std::map<unsigned int, unsigned int> freeByOffset;
+		std::set<std::pair<unsigned int, unsigned int>> freeBySize;
+		// Live ranges by first vertex: the vertex count and the owner
+		std::map<unsigned int, std::pair<unsigned int, VertexBuffer*>> used;
+		// The instance buffer attached to the VAO, 0 if none
+		unsigned int instanceVboId;
+	};
+
+	unsigned int vertexSizeInBytes;
+	unsigned int verticesPerBlock;
+	std::vector<Block> blocks;
+	void (*setUpLayout)();
+
+public:
+	VertexArena(unsigned int vertexSizeInBytes, unsigned int verticesPerBlock);
+	~VertexArena();
+
+	inline unsigned int GetVertexSizeInBytes() const { return vertexSizeInBytes; }
+	inline unsigned int GetNumberOfBlocks() const { 
+		return static_cast<unsigned int>(blocks.size()); 
+	}
+	unsigned int GetNumberOfFreeVertices() const;
+	unsigned int GetLargestFreeRange() const;
+
+	template <typename TLayout>
+	void SetLayout();
+
+	// Finds a range for the buffer's vertices, sends them and points the
+	// buffer at the block. A buffer that is already placed moves only when
+	// its size changed. An empty buffer is left out of the blocks.
+	void Place(VertexBuffer& buffer);
+	void Release(VertexBuffer& buffer);
+	// Feeds the per-instance world matrices into the block's VAO, which
+	// must be selected; does nothing when already attached
+	void AttachInstanceBuffer(unsigned int blockIndex, unsigned int instanceVboId);
+	// Packs every block's live ranges to the front so the free space of a
+	// block is one range. Moves the data on the GPU and updates the owners.
+	void Defragment();
+	// Creates the blocks again after the GL context was lost and places
+	// every mesh in them anew; throws before touching anything if a mesh
+	// discarded its vertices
+	void RecreateAfterContextLoss();
+
+private:
+	unsigned int CreateBlock();
+	void RecordVertexArray(Block& block);
+	void AddFreeRange(Block& block, unsigned int offset, unsigned int count);
+	void RemoveFreeRange(Block& block, unsigned int offset, unsigned int count);
+	bool TryAllocate(Block& block, unsigned int count, unsigned int& offset);
+	void Free(Block& block, unsigned int offset, unsigned int count);
+};
+
+template <typename TLayout>
+void VertexArena::SetLayout()
+{
+	if (TLayout::stride != vertexSizeInBytes) {
+		throw "Layout stride does not match the vertex size!";
+	}
+	setUpLayout = &TLayout::SetUp;
+	for (auto& block : blocks) {
+		RecordVertexArray(block);
+	}
+}
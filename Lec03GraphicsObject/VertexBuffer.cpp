@@ -1,18 +1,150 @@
 #include "VertexBuffer.h"
+#include "MeshOptimizer.h"
+#include "FrameInvalidation.h"
+#include <algorithm>
 #include <cstdarg>
+#include <cmath>
+#include <cstring>
+#include <string_view>
+#include <unordered_map>
+
+// Groups byte i of every vertex together, then run-length codes the result
+// PackBits style: a header h < 128 is followed by h + 1 literal bytes, a
+// header h > 128 by one byte repeated 257 - h times. Vertex streams repeat
+// exponent, color and zero bytes, which the grouping turns into runs.
+static std::vector<unsigned char> CompressVertexBytes(
+	const std::vector<unsigned char>& data, unsigned int vertexSizeInBytes)
+{
+	std::size_t numberOfVertices = data.size() / vertexSizeInBytes;
+	std::vector<unsigned char> grouped(data.size());
+	for (std::size_t vertex = 0; vertex < numberOfVertices; vertex++) {
+		for (unsigned int byte = 0; byte < vertexSizeInBytes; byte++) {
+			grouped[byte * numberOfVertices + vertex] = 
+				data[vertex * vertexSizeInBytes + byte];
+		}
+	}
+
+	std::vector<unsigned char> compressed;
+	compressed.reserve(grouped.size() / 4);
+	auto runLength = [&](std::size_t at) {
+		std::size_t length = 1;
+		while (at + length < grouped.size() && length < 128 &&
+			grouped[at + length] == grouped[at]) {
+			length++;
+		}
+		return length;
+	};
+	std::size_t at = 0;
+	while (at < grouped.size()) {
+		std::size_t run = runLength(at);
+		if (run >= 3) {
+			compressed.push_back(static_cast<unsigned char>(257 - run));
+			compressed.push_back(grouped[at]);
+			at += run;
+			continue;
+		}
+		std::size_t literalStart = at;
+		while (at < grouped.size() && at - literalStart < 128 && runLength(at) < 3) {
+			at++;
+		}
+		compressed.push_back(static_cast<unsigned char>(at - literalStart - 1));
+		compressed.insert(
+			compressed.end(), grouped.begin() + literalStart, grouped.begin() + at);
+	}
+	compressed.shrink_to_fit();
+	return compressed;
+}
+
+static void DecompressVertexBytes(
+	const std::vector<unsigned char>& compressed, unsigned int vertexSizeInBytes,
+	std::size_t numberOfVertices, std::vector<unsigned char>& data)
+{
+	std::vector<unsigned char> grouped;
+	grouped.reserve(numberOfVertices * vertexSizeInBytes);
+	std::size_t at = 0;
+	while (at < compressed.size()) {
+		unsigned char header = compressed[at++];
+		if (header < 128) {
+			grouped.insert(
+				grouped.end(), compressed.begin() + at, compressed.begin() + at + header + 1);
+			at += header + 1;
+		}
+		else if (header > 128) {
+			grouped.insert(grouped.end(), 257 - header, compressed[at++]);
+		}
+	}
+
+	data.resize(grouped.size());
+	for (std::size_t vertex = 0; vertex < numberOfVertices; vertex++) {
+		for (unsigned int byte = 0; byte < vertexSizeInBytes; byte++) {
+			data[vertex * vertexSizeInBytes + byte] = 
+				grouped[byte * numberOfVertices + vertex];
+		}
+	}
+}
 
 
 VertexBuffer::VertexBuffer(unsigned int numElementsPerVertex)
 {
 	numberOfElementsPerVertex = numElementsPerVertex;
+	vertexSizeInBytes = sizeof(float) * numElementsPerVertex;
 	numberOfVertices = 0;
+	firstVertex = 0;
+	numberOfAllocatedVertices = 0;
+	areIndicesDirty = false;
 	primitiveType = GL_TRIANGLES;
+	setUpLayout = nullptr;
+	isPlacedInArena = false;
+	arenaBlock = 0;
+	readPosition = nullptr;
+	areBoundsDirty = true;
+	boundsVersion = 0;
+	triangleBvhVersion = 0;
+	instanceVboId = 0;
+	retention = VertexRetention::Keep;
+	isVertexDataReleased = false;
+	accountedCpuBytes = 0;
+	accountedGpuBytes = 0;
 	glGenBuffers(1, &vboId);
+	glGenVertexArrays(1, &vaoId);
+}
+
+VertexBuffer::VertexBuffer(std::shared_ptr<VertexArena> arena)
+{
+	vertexSizeInBytes = arena->GetVertexSizeInBytes();
+	numberOfElementsPerVertex = vertexSizeInBytes / sizeof(float);
+	numberOfVertices = 0;
+	firstVertex = 0;
+	numberOfAllocatedVertices = 0;
+	areIndicesDirty = false;
+	primitiveType = GL_TRIANGLES;
+	setUpLayout = nullptr;
+	this->arena = arena;
+	isPlacedInArena = false;
+	arenaBlock = 0;
+	readPosition = nullptr;
+	areBoundsDirty = true;
+	boundsVersion = 0;
+	triangleBvhVersion = 0;
+	instanceVboId = 0;
+	retention = VertexRetention::Keep;
+	isVertexDataReleased = false;
+	accountedCpuBytes = 0;
+	accountedGpuBytes = 0;
+	vboId = 0;
+	vaoId = 0;
 }
 
 VertexBuffer::~VertexBuffer()
 {
-	glDeleteBuffers(1, &vboId);
+	VertexMemory::AddCpuBytes(-accountedCpuBytes);
+	VertexMemory::AddGpuBytes(-accountedGpuBytes);
+	if (arena != nullptr) {
+		arena->Release(*this);
+		return;
+	}
+	GLState::DeleteVertexArrays(1, &vaoId);
+	GLState::DeleteBuffers(1, &vboId);
 }
 
 void VertexBuffer::AddVertexData(unsigned int count, ...)
@@ -20,47 +152,486 @@ void VertexBuffer::AddVertexData(unsigned int count, ...)
 	if (count != numberOfElementsPerVertex) {
 		throw "Invalid vertex data count!";
 	}
+	EnsureVertexData();
 	va_list args;
 	va_start(args, count);
 	while (count > 0) {
 		// The default is double, so accept as double and then cast to
 		// float.
-		vertexData.push_back(static_cast<float>(va_arg(args, double)));
+		float component = static_cast<float>(va_arg(args, double));
+		const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&component);
+		vertexData.insert(vertexData.end(), bytes, bytes + sizeof(float));
 		count--;
 	}
 	numberOfVertices++;
 	va_end(args);
+	MarkBoundsDirty();
+	UpdateCpuAccounting();
+}
+
+void VertexBuffer::ReserveVertices(std::size_t count)
+{
+	EnsureVertexData();
+	vertexData.reserve(vertexData.size() + count * vertexSizeInBytes);
+	UpdateCpuAccounting();
+}
+
+void VertexBuffer::ClearVertices()
+{
+	vertexData.clear();
+	compressedData.clear();
+	isVertexDataReleased = false;
+	numberOfVertices = 0;
+	MarkBoundsDirty();
+	UpdateCpuAccounting();
+}
+
+void VertexBuffer::AddVertices(std::span<const float> components)
+{
+	if (components.size() % numberOfElementsPerVertex != 0) {
+		throw "Invalid vertex data count!";
+	}
+	AppendVertexBytes(
+		components.data(), components.size() / numberOfElementsPerVertex);
+}
+
+void VertexBuffer::AppendVertexBytes(const void* vertices, std::size_t count)
+{
+	EnsureVertexData();
+	const unsigned char* first = static_cast<const unsigned char*>(vertices);
+	// A single range insert grows the storage at most once
+	vertexData.insert(vertexData.end(), first, first + count * vertexSizeInBytes);
+	numberOfVertices += static_cast<unsigned int>(count);
+	MarkBoundsDirty();
+	UpdateCpuAccounting();
+}
+
+void VertexBuffer::SetVertices(
+	unsigned int firstVertex, std::span<const float> components)
+{
+	if (components.size() % numberOfElementsPerVertex != 0) {
+		throw "Invalid vertex data count!";
+	}
+	SetVertexBytes(
+		firstVertex, components.data(), components.size() / numberOfElementsPerVertex);
+}
+
+void VertexBuffer::SetVertexBytes(
+	unsigned int firstVertex, const void* vertices, std::size_t count)
+{
+	if (firstVertex + count > numberOfVertices) {
+		throw "Vertex range out of bounds!";
+	}
+	EnsureVertexData();
+	std::memcpy(
+		vertexData.data() + static_cast<std::size_t>(firstVertex) * vertexSizeInBytes,
+		vertices, count * vertexSizeInBytes);
+	MarkDirty(firstVertex, static_cast<unsigned int>(count));
+}
+
+void VertexBuffer::MarkDirty(unsigned int firstVertex, unsigned int count)
+{
+	if (count == 0) {
+		return;
+	}
+	MarkBoundsDirty();
+	// Extend the last range when edits walk forward through the buffer
+	if (!dirtyRanges.empty() && dirtyRanges.back().second == firstVertex) {
+		dirtyRanges.back().second = firstVertex + count;
+		return;
+	}
+	dirtyRanges.emplace_back(firstVertex, firstVertex + count);
+}
+
+unsigned long long VertexBuffer::UploadDirtyRanges()
+{
+	if (numberOfVertices != numberOfAllocatedVertices || areIndicesDirty) {
+		StaticAllocate();
+		return vertexData.size();
+	}
+	if (dirtyRanges.empty()) {
+		return 0;
+	}
+
+	std::sort(dirtyRanges.begin(), dirtyRanges.end());
+	unsigned long long bytesUploaded = 0;
+	auto send = [&](unsigned int first, unsigned int last) {
+		unsigned long long offset = 
+			static_cast<unsigned long long>(first) * vertexSizeInBytes;
+		unsigned long long size = 
+			static_cast<unsigned long long>(last - first) * vertexSizeInBytes;
+		// firstVertex is non-zero when the buffer lives in an arena block
+		unsigned long long bufferOffset = 
+			static_cast<unsigned long long>(firstVertex) * vertexSizeInBytes + offset;
+		glBufferSubData(GL_ARRAY_BUFFER, bufferOffset, size, vertexData.data() + offset);
+		bytesUploaded += size;
+	};
+	auto merged = dirtyRanges.front();
+	for (const auto& range : dirtyRanges) {
+		if (range.first <= merged.second) {
+			merged.second = std::max(merged.second, range.second);
+			continue;
+		}
+		send(merged.first, merged.second);
+		merged = range;
+	}
+	send(merged.first, merged.second);
+	dirtyRanges.clear();
+	ApplyRetention();
+	return bytesUploaded;
+}
+
+void VertexBuffer::WeldVertices()
+{
+	EnsureVertexData();
+	const unsigned char* data = vertexData.data();
+	// The map keys are vertex numbers; hashing and comparing look at the
+	// vertex bytes so no vertex is ever copied into a key
+	auto hashVertex = [&](unsigned int vertex) {
+		const char* bytes = reinterpret_cast<const char*>(
+			data + static_cast<std::size_t>(vertex) * vertexSizeInBytes);
+		return std::hash<std::string_view>{}(std::string_view(bytes, vertexSizeInBytes));
+	};
+	auto isSameVertex = [&](unsigned int a, unsigned int b) {
+		return std::memcmp(
+			data + static_cast<std::size_t>(a) * vertexSizeInBytes,
+			data + static_cast<std::size_t>(b) * vertexSizeInBytes, 
+			vertexSizeInBytes) == 0;
+	};
+	std::unordered_map<unsigned int, unsigned int, 
+		decltype(hashVertex), decltype(isSameVertex)>
+		uniqueVertices(numberOfVertices, hashVertex, isSameVertex);
+
+	std::vector<unsigned int> remap(numberOfVertices);
+	std::vector<unsigned char> weldedData;
+	weldedData.reserve(vertexData.size());
+	unsigned int numberOfUniqueVertices = 0;
+	for (unsigned int vertex = 0; vertex < numberOfVertices; vertex++) {
+		auto [item, isNew] = uniqueVertices.try_emplace(vertex, numberOfUniqueVertices);
+		if (isNew) {
+			const unsigned char* first = 
+				data + static_cast<std::size_t>(vertex) * vertexSizeInBytes;
+			weldedData.insert(weldedData.end(), first, first + vertexSizeInBytes);
+			numberOfUniqueVertices++;
+		}
+		remap[vertex] = item->second;
+	}
+
+	if (indexBuffer == nullptr) {
+		// Drawing vertex i of the old list is drawing remap[i] of the new one
+		indexBuffer = std::make_shared<IndexBuffer>();
+		indexBuffer->AddIndices(remap);
+	}
+	else {
+		indexBuffer->RemapIndices(remap);
+	}
+	vertexData = std::move(weldedData);
+	numberOfVertices = numberOfUniqueVertices;
+	areIndicesDirty = true;
+	FrameInvalidation::Invalidate();
+	UpdateCpuAccounting();
+}
+
+VertexCacheReport VertexBuffer::OptimizeVertexCache()
+{
+	if (primitiveType != GL_TRIANGLES) {
+		throw "Only triangle lists can be optimized for the vertex cache!";
+	}
+	if (indexBuffer == nullptr) {
+		WeldVertices();
+	}
+	EnsureVertexData();
+
+	VertexCacheReport report;
+	report.acmrBefore = 
+		MeshOptimizer::ComputeACMR(indexBuffer->GetIndices(), numberOfVertices);
+	std::vector<unsigned int> indices = 
+		MeshOptimizer::OptimizeVertexCache(indexBuffer->GetIndices(), numberOfVertices);
+	std::vector<unsigned int> remap = 
+		MeshOptimizer::OptimizeVertexFetch(indices, numberOfVertices);
+	report.acmrAfter = MeshOptimizer::ComputeACMR(indices, numberOfVertices);
+
+	std::vector<unsigned char> reordered(vertexData.size());
+	for (unsigned int vertex = 0; vertex < numberOfVertices; vertex++) {
+		std::memcpy(
+			reordered.data() + static_cast<std::size_t>(remap[vertex]) * vertexSizeInBytes,
+			vertexData.data() + static_cast<std::size_t>(vertex) * vertexSizeInBytes,
+			vertexSizeInBytes);
+	}
+	vertexData = std::move(reordered);
+	indexBuffer->SetIndices(std::move(indices));
+	areIndicesDirty = true;
+	FrameInvalidation::Invalidate();
+	UpdateCpuAccounting();
+	return report;
 }
 
 void VertexBuffer::StaticAllocate()
 {
-	unsigned long long bytesToAllocate = vertexData.size() * sizeof(float);
+	if (arena != nullptr) {
+		if (indexBuffer != nullptr) {
+			// The element buffer binding would belong to the shared VAO
+			throw "Indexed buffers cannot be placed in a vertex arena!";
+		}
+		EnsureVertexData();
+		arena->Place(*this);
+		numberOfAllocatedVertices = numberOfVertices;
+		dirtyRanges.clear();
+		triangleBvh = nullptr;
+		GetTriangleBvh();
+		ApplyRetention();
+		return;
+	}
+	EnsureVertexData();
+	unsigned long long bytesToAllocate = vertexData.size();
 	glBufferData(
 		GL_ARRAY_BUFFER, bytesToAllocate, vertexData.data(), GL_STATIC_DRAW);
+	SetGpuAccounting(static_cast<long long>(bytesToAllocate));
+	numberOfAllocatedVertices = numberOfVertices;
+	dirtyRanges.clear();
+	areIndicesDirty = false;
+	RecordVertexArray();
+	// The indices may have changed without the bounds, so rebuild; now,
+	// while the vertices are still here and so the first pick does not
+	// have to wait for it
+	triangleBvh = nullptr;
+	GetTriangleBvh();
+	ApplyRetention();
+}
+
+void VertexBuffer::RecreateAfterContextLoss()
+{
+	// The old names died with the context, so there is nothing to delete
+	if (arena != nullptr) {
+		// Frees the range the mesh holds, if the arena still lists it
+		arena->Release(*this);
+	}
+	else {
+		glGenBuffers(1, &vboId);
+		glGenVertexArrays(1, &vaoId);
+		// The new VAO has no instance stream, whatever its name
+		instanceVboId = 0;
+	}
+	if (indexBuffer != nullptr) {
+		indexBuffer->RecreateAfterContextLoss();
+	}
+	Select();
+	StaticAllocate();
+	Deselect();
+}
+
+void VertexBuffer::EnsureVertexData()
+{
+	if (!isVertexDataReleased) {
+		return;
+	}
+	if (compressedData.empty() && numberOfVertices > 0) {
+		throw "The vertex data was discarded after upload!";
+	}
+	DecompressVertexBytes(
+		compressedData, vertexSizeInBytes, numberOfVertices, vertexData);
+	compressedData.clear();
+	compressedData.shrink_to_fit();
+	isVertexDataReleased = false;
+	UpdateCpuAccounting();
+}
+
+void VertexBuffer::ApplyRetention()
+{
+	if (retention == VertexRetention::Keep || isVertexDataReleased) {
+		return;
+	}
+	// The bounds are taken while the vertices are still here
+	if (areBoundsDirty) {
+		UpdateBounds();
+	}
+	if (retention == VertexRetention::KeepCompressed) {
+		compressedData = CompressVertexBytes(vertexData, vertexSizeInBytes);
+	}
+	vertexData.clear();
+	vertexData.shrink_to_fit();
+	isVertexDataReleased = true;
+	UpdateCpuAccounting();
+}
+
+const BoundingBox& VertexBuffer::GetBoundingBox()
+{
+	if (areBoundsDirty) {
+		UpdateBounds();
+	}
+	return localBox;
+}
+
+const BoundingSphere& VertexBuffer::GetBoundingSphere()
+{
+	if (areBoundsDirty) {
+		UpdateBounds();
+	}
+	return localSphere;
+}
+
+void VertexBuffer::RefreshBounds()
+{
+	if (areBoundsDirty) {
+		UpdateBounds();
+	}
+}
+
+const MeshBvh* VertexBuffer::GetTriangleBvh()
+{
+	if (primitiveType != GL_TRIANGLES) {
+		return nullptr;
+	}
+	RefreshBounds();
+	if (triangleBvh != nullptr && triangleBvhVersion == boundsVersion) {
+		return triangleBvh.get();
+	}
+	if (isVertexDataReleased && compressedData.empty()) {
+		return nullptr;
+	}
+	EnsureVertexData();
+	std::vector<glm::vec3> positions(numberOfVertices);
+	for (unsigned int i = 0; i < numberOfVertices; i++) {
+		positions[i] = ReadPosition(
+			vertexData.data() + static_cast<std::size_t>(i) * vertexSizeInBytes);
+	}
+	std::span<const unsigned int> indices;
+	if (indexBuffer != nullptr) {
+		indices = indexBuffer->GetIndices();
+	}
+	triangleBvh = std::make_shared<MeshBvh>(positions, indices);
+	triangleBvhVersion = boundsVersion;
+	return triangleBvh.get();
+}
+
+void VertexBuffer::UpdateBounds()
+{
+	EnsureVertexData();
+	localBox = BoundingBox();
+	localSphere = BoundingSphere();
+	for (std::size_t offset = 0; offset < vertexData.size(); offset += vertexSizeInBytes) {
+		localBox.Include(ReadPosition(&vertexData[offset]));
+	}
+	if (!localBox.IsEmpty()) {
+		// Centered on the box, which is close to the tightest sphere for
+		// the usual meshes and costs one more pass
+		float radiusSquared = 0.0f;
+		glm::vec3 center = localBox.GetCenter();
+		for (std::size_t offset = 0; offset < vertexData.size(); offset += vertexSizeInBytes) {
+			glm::vec3 toVertex = ReadPosition(&vertexData[offset]) - center;
+			radiusSquared = std::max(radiusSquared, glm::dot(toVertex, toVertex));
+		}
+		localSphere = { center, std::sqrt(radiusSquared) };
+	}
+	areBoundsDirty = false;
+	boundsVersion++;
+}
+
+glm::vec3 VertexBuffer::ReadPosition(const unsigned char* vertex) const
+{
+	if (readPosition != nullptr) {
+		return readPosition(vertex);
+	}
+	// Float attributes added one by one, position at index 0
+	std::size_t byteOffset = 0;
+	unsigned int numberOfComponents = std::min(numberOfElementsPerVertex, 3u);
+	for (const auto& attr : attributes) {
+		if (attr.index == 0) {
+			byteOffset = reinterpret_cast<std::size_t>(attr.byteOffset);
+			numberOfComponents = std::min(attr.numberOfComponents, 3u);
+		}
+	}
+	glm::vec3 position(0.0f);
+	std::memcpy(&position, vertex + byteOffset, numberOfComponents * sizeof(float));
+	return position;
+}
+
+void VertexBuffer::MarkBoundsDirty()
+{
+	// Only the first edit after the bounds were computed needs to ask for
+	// a frame; the frame that draws it computes them again
+	if (!areBoundsDirty) {
+		areBoundsDirty = true;
+		FrameInvalidation::Invalidate();
+	}
+}
+
+void VertexBuffer::UpdateCpuAccounting()
+{
+	long long bytes = 
+		static_cast<long long>(vertexData.capacity() + compressedData.capacity());
+	if (bytes != accountedCpuBytes) {
+		VertexMemory::AddCpuBytes(bytes - accountedCpuBytes);
+		accountedCpuBytes = bytes;
+	}
+}
+
+void VertexBuffer::SetGpuAccounting(long long bytes)
+{
+	VertexMemory::AddGpuBytes(bytes - accountedGpuBytes);
+	accountedGpuBytes = bytes;
+}
+
+void VertexBuffer::RecordVertexArray()
+{
+	// Record the attribute setup once; drawing only needs to bind the VAO.
+	// The attribute pointers capture the currently selected buffer.
+	SelectVertexArray();
+	SetUpAttributeInterpretration();
+	if (indexBuffer != nullptr) {
+		// The element buffer binding is VAO state, so upload it while
+		// the VAO is bound and leave it bound
+		indexBuffer->Select();
+		indexBuffer->StaticAllocate();
+	}
+	DeselectVertexArray();
 }
 
 void VertexBuffer::AddVertexAttribute(
-	const std::string& name, unsigned int index, 
-	unsigned int numberOfElements, unsigned int offsetCount)
+	unsigned int index, unsigned int numberOfElements, 
+	unsigned int offsetCount)
 {
-	unsigned int vertexSizeInBytes = sizeof(float) * numberOfElementsPerVertex;
 	unsigned int bytesToNext = vertexSizeInBytes;
 	unsigned long long offsetBytes = sizeof(float) * offsetCount;
 	VertexAttribute attr = { 
 		index, numberOfElements, GL_FLOAT, GL_FALSE, 
 		bytesToNext, (void*)offsetBytes 
 	};
-	attributeMap[name] = attr;
+	for (auto& existing : attributes) {
+		if (existing.index == index) {
+			existing = attr;
+			return;
+		}
+	}
+	attributes.push_back(attr);
 }
 
 void VertexBuffer::SetUpAttributeInterpretration()
 {
-	for (const std::pair<const std::string, VertexAttribute>& item : attributeMap) {
-		const auto& attr = item.second;
-		glEnableVertexAttribArray(attr.index);
+	if (setUpLayout != nullptr) {
+		setUpLayout();
+		return;
+	}
+	for (const auto& attr : attributes) {
+		GLState::EnableVertexAttribArray(attr.index);
 		glVertexAttribPointer(
 			attr.index, attr.numberOfComponents, attr.type,
 			attr.isNormalized, attr.bytesToNext, attr.byteOffset
 		);
 	}
 }
+
+void VertexBuffer::AttachInstanceBuffer(unsigned int instanceVboId)
+{
+	// The binding belongs to the VAO, which a placed mesh shares with its
+	// block and which may change when the mesh moves to another block
+	if (isPlacedInArena) {
+		arena->AttachInstanceBuffer(arenaBlock, instanceVboId);
+		return;
+	}
+	if (this->instanceVboId == instanceVboId) {
+		return;
+	}
+	InstanceLayout::SetUp(instanceVboId);
+	this->instanceVboId = instanceVboId;
+}
@@ -1,8 +1,18 @@
 #pragma once
 #include <glad/glad.h> 
+#include <memory>
+#include <utility>
 #include <vector>
-#include <unordered_map>
-#include <string>
+#include <span>
+#include <type_traits>
+
+#include "Bounds.h"
+#include "GLState.h"
+#include "IndexBuffer.h"
+#include "MeshBvh.h"
+#include "VertexArena.h"
+#include "VertexLayout.h"
+#include "VertexMemory.h"
 
 struct VertexAttribute {
 	unsigned int index;
@@ -13,32 +23,250 @@ struct VertexAttribute {
 	void* byteOffset;
 };
 
+// What a buffer keeps of its vertices once they are in the GL buffer
+enum class VertexRetention {
+	Keep,
+	// Frees the CPU copy; the vertices can no longer be edited
+	DiscardAfterUpload,
+	// Keeps a compressed copy that is expanded again on edit or after
+	// the GL context was lost
+	KeepCompressed
+};
+
+// Vertex shader runs per triangle before and after OptimizeVertexCache
+struct VertexCacheReport {
+	float acmrBefore;
+	float acmrAfter;
+};
+
 class VertexBuffer
 {
+	friend class VertexArena;
+
 protected:
+	// 32-bit elements per vertex: floats, or words of a packed vertex
 	unsigned int numberOfElementsPerVertex;
+	unsigned int vertexSizeInBytes;
 	unsigned int numberOfVertices;
+	// Where drawing starts in the GL buffer, in vertices
+	unsigned int firstVertex;
 	unsigned int vboId;
+	unsigned int vaoId;
 	int primitiveType;
-	std::vector<float> vertexData;
-	std::unordered_map<std::string, VertexAttribute> attributeMap;
+	// Raw vertex bytes, exactly as they are sent to GL
+	std::vector<unsigned char> vertexData;
+	std::vector<VertexAttribute> attributes;
+	// Set by SetLayout, replaces the attribute list when present
+	void (*setUpLayout)();
+	std::shared_ptr<IndexBuffer> indexBuffer;
+	// Vertices in the GL buffer, and the [first, last) vertex ranges edited
+	// since they were sent
+	unsigned int numberOfAllocatedVertices;
+	std::vector<std::pair<unsigned int, unsigned int>> dirtyRanges;
+	// Set when the indices changed; they are sent with a full allocation
+	bool areIndicesDirty;
+	// When set, the vertices live in a range of one of the arena's blocks
+	// and vboId/vaoId belong to that block
+	std::shared_ptr<VertexArena> arena;
+	bool isPlacedInArena;
+	unsigned int arenaBlock;
+	// Reads the position out of one vertex, set by SetLayout
+	glm::vec3 (*readPosition)(const unsigned char* vertex);
+	// Local bounds of the positions, recomputed after vertex edits
+	BoundingBox localBox;
+	BoundingSphere localSphere;
+	bool areBoundsDirty;
+	// Bumped whenever the bounds are recomputed
+	unsigned long long boundsVersion;
+	// Built for picking by StaticAllocate, and again on the next pick
+	// after the bounds version moved on
+	std::shared_ptr<MeshBvh> triangleBvh;
+	unsigned long long triangleBvhVersion;
+	// The instance buffer attached to the buffer's own VAO, 0 if none;
+	// arena blocks keep this for their shared VAO
+	unsigned int instanceVboId;
+	VertexRetention retention;
+	std::vector<unsigned char> compressedData;
+	bool isVertexDataReleased;
+	// What this buffer has reported to VertexMemory
+	long long accountedCpuBytes;
+	long long accountedGpuBytes;
 
 public:
 	VertexBuffer(unsigned int numElementsPerVertex = 3);
-	~VertexBuffer();
+	// A mesh suballocated from the arena, no GL objects of its own
+	VertexBuffer(std::shared_ptr<VertexArena> arena);
+	virtual ~VertexBuffer();
 
-	inline void Select() { glBindBuffer(GL_ARRAY_BUFFER, vboId); }
-	inline void Deselect() { glBindBuffer(GL_ARRAY_BUFFER, 0); }
+	inline void Select() { GLState::BindBuffer(GL_ARRAY_BUFFER, vboId); }
+	inline void Deselect() { GLState::BindBuffer(GL_ARRAY_BUFFER, 0); }
+	inline void SelectVertexArray() { GLState::BindVertexArray(vaoId); }
+	inline void DeselectVertexArray() { GLState::BindVertexArray(0); }
 	inline unsigned int GetNumberOfVertices() const { return numberOfVertices; }
+	inline unsigned int GetVertexSizeInBytes() const { return vertexSizeInBytes; }
+	inline unsigned int GetFirstVertex() const { return firstVertex; }
+	inline unsigned int GetVertexArrayId() const { return vaoId; }
+	inline unsigned int GetBufferId() const { return vboId; }
 	inline int GetPrimitiveType() const { return primitiveType; }
 	inline void SetPrimitiveType(int primitiveType) { this->primitiveType = primitiveType; }
+	inline const std::shared_ptr<IndexBuffer>& GetIndexBuffer() const { return indexBuffer; }
+	inline void SetIndexBuffer(std::shared_ptr<IndexBuffer> indexBuffer) { 
+		this->indexBuffer = indexBuffer; 
+	}
+	inline bool IsIndexed() const { return indexBuffer != nullptr; }
+	inline VertexRetention GetRetention() const { return retention; }
+	inline void SetRetention(VertexRetention retention) { this->retention = retention; }
+	inline bool IsDirty() const { 
+		return !dirtyRanges.empty() || numberOfVertices != numberOfAllocatedVertices ||
+			areIndicesDirty;
+	}
 
 	// Variadic function
 	void AddVertexData(unsigned int count, ...);
-	void StaticAllocate();
+	void ReserveVertices(std::size_t count);
+	// Drops the vertices but keeps the storage for refilling
+	void ClearVertices();
+	// Appends a contiguous block of components, count must be a multiple of
+	// the number of elements per vertex
+	void AddVertices(std::span<const float> components);
+	// Appends a contiguous block of vertices, e.g. AddVertices<VertexData>(data)
+	template <typename TVertex>
+	void AddVertices(std::span<const TVertex> vertices);
+	// Converts each source vertex on ingest, e.g. 
+	// AddVertices<PackedColorVertex>(data, PackColorVertex)
+	template <typename TVertex, typename TSource>
+	void AddVertices(
+		std::type_identity_t<std::span<const TSource>> source,
+		TVertex (*convert)(const TSource&));
+	// Overwrites vertices starting at firstVertex and marks them for upload
+	void SetVertices(unsigned int firstVertex, std::span<const float> components);
+	template <typename TVertex>
+	void SetVertices(unsigned int firstVertex, std::span<const TVertex> vertices);
+	// Gives write access to count vertices and marks them for upload
+	template <typename TElement = float>
+	std::span<TElement> EditVertices(unsigned int firstVertex, unsigned int count);
+	void MarkDirty(unsigned int firstVertex, unsigned int count);
+	// Merges overlapping or touching dirty ranges and sends each with
+	// glBufferSubData, the buffer must be selected. Falls back to a full
+	// StaticAllocate when the vertex count or the indices changed. Returns
+	// the bytes sent.
+	virtual unsigned long long UploadDirtyRanges();
+	// Merges bit-identical vertices and draws through an index buffer,
+	// creating one if the buffer is not indexed yet
+	void WeldVertices();
+	// Reorders an indexed triangle list for the post-transform cache, then
+	// reorders the vertices by first use. Welds first if not indexed.
+	VertexCacheReport OptimizeVertexCache();
+	virtual void StaticAllocate();
+	// Creates new GL objects and sends the kept or compressed vertices
+	// again, for use after the GL context was lost. A mesh in an arena is
+	// placed again in the arena's blocks, so recreate the arena first.
+	virtual void RecreateAfterContextLoss();
 	void AddVertexAttribute(
-		const std::string& name, unsigned int index, 
-		unsigned int numberOfElements, unsigned int offsetCount=0);
+		unsigned int index, unsigned int numberOfElements, 
+		unsigned int offsetCount=0);
+	// Uses a compile-time VertexLayout, e.g. SetLayout<VertexDataLayout>()
+	template <typename TLayout>
+	void SetLayout();
 	void SetUpAttributeInterpretration();
+	// Bounds of the positions in attribute 0 (or the first three floats
+	// when there is no layout); empty when there are no vertices
+	const BoundingBox& GetBoundingBox();
+	const BoundingSphere& GetBoundingSphere();
+	inline unsigned long long GetBoundsVersion() const { return boundsVersion; }
+	// Recomputes the bounds now if vertices changed, so that later reads
+	// do not write and can come from several threads
+	void RefreshBounds();
+	// The triangles' BVH for picking, rebuilt after vertex edits. nullptr
+	// unless the buffer draws GL_TRIANGLES, and when the vertices were
+	// discarded before a rebuild.
+	const MeshBvh* GetTriangleBvh();
+	// Feeds the per-instance world matrices from the given buffer into the
+	// VAO, which must be selected; does nothing when already attached
+	void AttachInstanceBuffer(unsigned int instanceVboId);
+
+protected:
+	// Expands a compressed copy, throws if the vertices were discarded
+	void EnsureVertexData();
+	void ApplyRetention();
+	void UpdateBounds();
+	// Called for every vertex edit. Invalidates the frame only when the
+	// bounds were clean, so a batch of edits invalidates it once.
+	void MarkBoundsDirty();
+	glm::vec3 ReadPosition(const unsigned char* vertex) const;
+	void UpdateCpuAccounting();
+	void SetGpuAccounting(long long bytes);
+	void AppendVertexBytes(const void* vertices, std::size_t count);
+	void SetVertexBytes(unsigned int firstVertex, const void* vertices, std::size_t count);
+	// Records the attribute setup and the element buffer into the VAO,
+	// the vertex buffer must be selected
+	void RecordVertexArray();
 };
 
+template <typename TVertex>
+void VertexBuffer::AddVertices(std::span<const TVertex> vertices)
+{
+	static_assert(std::is_trivially_copyable_v<TVertex>,
+		"Vertices must be plain data");
+	if (sizeof(TVertex) != vertexSizeInBytes) {
+		throw "Invalid vertex data size!";
+	}
+	AppendVertexBytes(vertices.data(), vertices.size());
+}
+
+template <typename TVertex, typename TSource>
+void VertexBuffer::AddVertices(
+	std::type_identity_t<std::span<const TSource>> source,
+	TVertex (*convert)(const TSource&))
+{
+	static_assert(std::is_trivially_copyable_v<TVertex>,
+		"Vertices must be plain data");
+	if (sizeof(TVertex) != vertexSizeInBytes) {
+		throw "Invalid vertex data size!";
+	}
+	EnsureVertexData();
+	ReserveVertices(source.size());
+	for (const TSource& vertex : source) {
+		TVertex converted = convert(vertex);
+		AppendVertexBytes(&converted, 1);
+	}
+}
+
+template <typename TVertex>
+void VertexBuffer::SetVertices(unsigned int firstVertex, std::span<const TVertex> vertices)
+{
+	static_assert(std::is_trivially_copyable_v<TVertex>,
+		"Vertices must be plain data");
+	if (sizeof(TVertex) != vertexSizeInBytes) {
+		throw "Invalid vertex data size!";
+	}
+	SetVertexBytes(firstVertex, vertices.data(), vertices.size());
+}
+
+template <typename TElement>
+std::span<TElement> VertexBuffer::EditVertices(unsigned int firstVertex, unsigned int count)
+{
+	if (vertexSizeInBytes % sizeof(TElement) != 0) {
+		throw "Vertices cannot be viewed as this type!";
+	}
+	if (firstVertex + count > numberOfVertices) {
+		throw "Vertex range out of bounds!";
+	}
+	EnsureVertexData();
+	MarkDirty(firstVertex, count);
+	return std::span<TElement>(
+		reinterpret_cast<TElement*>(
+			vertexData.data() + static_cast<std::size_t>(firstVertex) * vertexSizeInBytes),
+		count * (vertexSizeInBytes / sizeof(TElement)));
+}
+
+template <typename TLayout>
+void VertexBuffer::SetLayout()
+{
+	if (TLayout::stride != vertexSizeInBytes) {
+		throw "Layout stride does not match the vertex size!";
+	}
+	setUpLayout = &TLayout::SetUp;
+	readPosition = &TLayout::ReadPosition;
+	MarkBoundsDirty();
+}
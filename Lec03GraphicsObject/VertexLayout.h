@@ -0,0 +1,268 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+#include <cstddef>
+#include <cstring>
+#include "GLState.h"
+
+// Maps the C++ type of a vertex member to its GL component count and type,
+// and reads a stored value back as GL would see it
+template <typename TComponent>
+struct VertexComponentTraits;
+
+template <>
+struct VertexComponentTraits<float> {
+	static constexpr int numberOfComponents = 1;
+	static constexpr GLenum type = GL_FLOAT;
+	static constexpr GLboolean isNormalized = GL_FALSE;
+
+	static glm::vec4 Unpack(const unsigned char* bytes) {
+		float value;
+		std::memcpy(&value, bytes, sizeof(value));
+		return glm::vec4(value, 0.0f, 0.0f, 1.0f);
+	}
+};
+
+template <>
+struct VertexComponentTraits<glm::vec2> {
+	static constexpr int numberOfComponents = 2;
+	static constexpr GLenum type = GL_FLOAT;
+	static constexpr GLboolean isNormalized = GL_FALSE;
+
+	static glm::vec4 Unpack(const unsigned char* bytes) {
+		glm::vec2 value;
+		std::memcpy(&value, bytes, sizeof(value));
+		return glm::vec4(value, 0.0f, 1.0f);
+	}
+};
+
+template <>
+struct VertexComponentTraits<glm::vec3> {
+	static constexpr int numberOfComponents = 3;
+	static constexpr GLenum type = GL_FLOAT;
+	static constexpr GLboolean isNormalized = GL_FALSE;
+
+	static glm::vec4 Unpack(const unsigned char* bytes) {
+		glm::vec3 value;
+		std::memcpy(&value, bytes, sizeof(value));
+		return glm::vec4(value, 1.0f);
+	}
+};
+
+template <>
+struct VertexComponentTraits<glm::vec4> {
+	static constexpr int numberOfComponents = 4;
+	static constexpr GLenum type = GL_FLOAT;
+	static constexpr GLboolean isNormalized = GL_FALSE;
+
+	static glm::vec4 Unpack(const unsigned char* bytes) {
+		glm::vec4 value;
+		std::memcpy(&value, bytes, sizeof(value));
+		return value;
+	}
+};
+
+// Packed attribute types. Each is filled on ingest with the glm packing
+// helpers and read by GL as a vec4 (unused components are ignored).
+
+// Four 16-bit floats, e.g. positions: 8 bytes instead of 12 or 16
+struct PackedHalf4 {
+	glm::uint16 bits[4];
+
+	static PackedHalf4 Pack(const glm::vec4& value) {
+		PackedHalf4 packed;
+		glm::uint64 word = glm::packHalf4x16(value);
+		std::memcpy(packed.bits, &word, sizeof(packed.bits));
+		return packed;
+	}
+};
+
+// Four signed 16-bit values mapped to [-1, 1]; positions must be scaled
+// into that range and scaled back by the world matrix
+struct PackedSnorm4x16 {
+	glm::int16 bits[4];
+
+	static PackedSnorm4x16 Pack(const glm::vec4& value) {
+		PackedSnorm4x16 packed;
+		glm::uint64 word = glm::packSnorm4x16(value);
+		std::memcpy(packed.bits, &word, sizeof(packed.bits));
+		return packed;
+	}
+};
+
+// Four unsigned bytes mapped to [0, 1], e.g. colors
+struct PackedUnorm4x8 {
+	glm::uint32 bits;
+
+	static PackedUnorm4x8 Pack(const glm::vec4& value) {
+		return { glm::packUnorm4x8(value) };
+	}
+};
+
+// Three signed 10-bit values and a 2-bit w mapped to [-1, 1], e.g. normals
+struct PackedSnorm3x10_1x2 {
+	glm::uint32 bits;
+
+	static PackedSnorm3x10_1x2 Pack(const glm::vec4& value) {
+		return { glm::packSnorm3x10_1x2(value) };
+	}
+};
+
+template <>
+struct VertexComponentTraits<PackedHalf4> {
+	static constexpr int numberOfComponents = 4;
+	static constexpr GLenum type = GL_HALF_FLOAT;
+	static constexpr GLboolean isNormalized = GL_FALSE;
+
+	static glm::vec4 Unpack(const unsigned char* bytes) {
+		glm::uint64 word;
+		std::memcpy(&word, bytes, sizeof(word));
+		return glm::unpackHalf4x16(word);
+	}
+};
+
+template <>
+struct VertexComponentTraits<PackedSnorm4x16> {
+	static constexpr int numberOfComponents = 4;
+	static constexpr GLenum type = GL_SHORT;
+	static constexpr GLboolean isNormalized = GL_TRUE;
+
+	static glm::vec4 Unpack(const unsigned char* bytes) {
+		glm::uint64 word;
+		std::memcpy(&word, bytes, sizeof(word));
+		return glm::unpackSnorm4x16(word);
+	}
+};
+
+template <>
+struct VertexComponentTraits<PackedUnorm4x8> {
+	static constexpr int numberOfComponents = 4;
+	static constexpr GLenum type = GL_UNSIGNED_BYTE;
+	static constexpr GLboolean isNormalized = GL_TRUE;
+
+	static glm::vec4 Unpack(const unsigned char* bytes) {
+		glm::uint32 word;
+		std::memcpy(&word, bytes, sizeof(word));
+		return glm::unpackUnorm4x8(word);
+	}
+};
+
+template <>
+struct VertexComponentTraits<PackedSnorm3x10_1x2> {
+	static constexpr int numberOfComponents = 4;
+	static constexpr GLenum type = GL_INT_2_10_10_10_REV;
+	static constexpr GLboolean isNormalized = GL_TRUE;
+
+	static glm::vec4 Unpack(const unsigned char* bytes) {
+		glm::uint32 word;
+		std::memcpy(&word, bytes, sizeof(word));
+		return glm::unpackSnorm3x10_1x2(word);
+	}
+};
+
+// One attribute of a vertex format, fully described at compile time
+template <unsigned int Index, typename TComponent, std::size_t Offset,
+	GLboolean Normalized = VertexComponentTraits<TComponent>::isNormalized>
+struct VertexAttributeFormat {
+	using ComponentType = TComponent;
+	static constexpr unsigned int index = Index;
+	static constexpr int numberOfComponents =
+		VertexComponentTraits<TComponent>::numberOfComponents;
+	static constexpr GLenum type = VertexComponentTraits<TComponent>::type;
+	static constexpr GLboolean isNormalized = Normalized;
+	static constexpr std::size_t byteOffset = Offset;
+
+	static void SetUp(GLsizei stride)
+	{
+		GLState::EnableVertexAttribArray(index);
+		glVertexAttribPointer(
+			index, numberOfComponents, type, isNormalized, stride,
+			reinterpret_cast<void*>(byteOffset)
+		);
+	}
+
+	static glm::vec4 Read(const unsigned char* vertex)
+	{
+		return VertexComponentTraits<TComponent>::Unpack(vertex + byteOffset);
+	}
+};
+
+// A vertex format: the vertex struct plus the attributes read from it.
+// SetUp expands to one fixed call sequence per attribute.
+template <typename TVertex, typename... TAttributes>
+struct VertexLayout {
+	using VertexType = TVertex;
+	static constexpr GLsizei stride = sizeof(TVertex);
+	static constexpr unsigned int numberOfAttributes = sizeof...(TAttributes);
+
+	static_assert(
+		((TAttributes::byteOffset + sizeof(typename TAttributes::ComponentType)
+			<= sizeof(TVertex)) && ...),
+		"An attribute reads past the end of the vertex");
+
+	static void SetUp()
+	{
+		(TAttributes::SetUp(stride), ...);
+	}
+
+	// Reads attribute 0, the position, e.g. for computing bounds
+	static glm::vec3 ReadPosition(const unsigned char* vertex)
+	{
+		glm::vec3 position(0.0f);
+		((TAttributes::index == 0 ?
+			(position = glm::vec3(TAttributes::Read(vertex)), 0) : 0), ...);
+		return position;
+	}
+};
+
+// Per-instance world matrices for instanced drawing, read by shaders as
+// layout(location = 12) in mat4 instanceWorld. The four columns take
+// locations 12 to 15 and come from vertex buffer binding 15, which the
+// per-vertex attributes (bindings 0 to 11) never touch.
+struct InstanceLayout {
+	static constexpr unsigned int firstLocation = 12;
+	static constexpr GLuint binding = 15;
+	static constexpr GLsizei stride = sizeof(glm::mat4);
+
+	static void SetUp(GLuint instanceVboId)
+	{
+		for (unsigned int column = 0; column < 4; column++) {
+			GLState::EnableVertexAttribArray(firstLocation + column);
+			glVertexAttribFormat(
+				firstLocation + column, 4, GL_FLOAT, GL_FALSE,
+				column * sizeof(glm::vec4));
+			glVertexAttribBinding(firstLocation + column, binding);
+		}
+		glVertexBindingDivisor(binding, 1);
+		glBindVertexBuffer(binding, instanceVboId, 0, stride);
+	}
+};
+
+struct VertexData {
+	glm::vec3 position, color;
+};
+
+using VertexDataLayout = VertexLayout<VertexData,
+	VertexAttributeFormat<0, glm::vec3, offsetof(VertexData, position)>,
+	VertexAttributeFormat<1, glm::vec3, offsetof(VertexData, color)>
+>;
+
+// VertexData in 12 bytes instead of 24
+struct PackedColorVertex {
+	PackedHalf4 position;
+	PackedUnorm4x8 color;
+};
+
+using PackedColorVertexLayout = VertexLayout<PackedColorVertex,
+	VertexAttributeFormat<0, PackedHalf4, offsetof(PackedColorVertex, position)>,
+	VertexAttributeFormat<1, PackedUnorm4x8, offsetof(PackedColorVertex, color)>
+>;
+
+inline PackedColorVertex PackColorVertex(const VertexData& vertex)
+{
+	return {
+		PackedHalf4::Pack(glm::vec4(vertex.position, 1.0f)),
+		PackedUnorm4x8::Pack(glm::vec4(vertex.color, 1.0f))
+	};
+}
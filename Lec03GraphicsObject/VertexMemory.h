@@ -0,0 +1,17 @@
+#pragma once
+#include <atomic>
+
+// Process-wide count of the bytes held for vertex data, on the CPU side
+// (vertex copies, compressed copies) and in GL buffers
+class VertexMemory
+{
+private:
+	static inline std::atomic<long long> cpuBytes = 0;
+	static inline std::atomic<long long> gpuBytes = 0;
+
+public:
+	static inline long long GetCpuBytes() { return cpuBytes.load(); }
+	static inline long long GetGpuBytes() { return gpuBytes.load(); }
+	static inline void AddCpuBytes(long long bytes) { cpuBytes += bytes; }
+	static inline void AddGpuBytes(long long bytes) { gpuBytes += bytes; }
+};
@@ -0,0 +1,85 @@
+#include "WorkerPool.h"
+
+WorkerPool::WorkerPool(std::size_t numberOfThreads)
+{
+	job = nullptr;
+	numberOfTasks = 0;
+	nextTask = 0;
+	numberOfFinishedTasks = 0;
+	generation = 0;
+	isStopping = false;
+	for (std::size_t i = 0; i < numberOfThreads; i++) {
+		threads.emplace_back(&WorkerPool::WorkerLoop, this);
+	}
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		isStopping = true;
+	}
+	workReady.notify_all();
+	for (auto& thread : threads) {
+		thread.join();
+	}
+}
+
+std::size_t WorkerPool::DefaultNumberOfThreads()
+{
+	unsigned int hardwareThreads = std::thread::hardware_concurrency();
+	return hardwareThreads > 1 ? hardwareThreads - 1 : 0;
+}
+
+void WorkerPool::ParallelFor(
+	std::size_t count, const std::function<void(std::size_t)>& job)
+{
+	if (count == 1 || threads.empty()) {
+		// Waking the threads would cost more than they could take over
+		for (std::size_t i = 0; i < count; i++) {
+			job(i);
+		}
+		return;
+	}
+	std::unique_lock<std::mutex> lock(mutex);
+	this->job = &job;
+	numberOfTasks = count;
+	nextTask = 0;
+	numberOfFinishedTasks = 0;
+	generation++;
+	workReady.notify_all();
+	RunTasks(lock);
+	workDone.wait(lock, [this] { return numberOfFinishedTasks == numberOfTasks; });
+	this->job = nullptr;
+}
+
+void WorkerPool::WorkerLoop()
+{
+	unsigned long long seenGeneration = 0;
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true) {
+		workReady.wait(lock, [&] { 
+			return isStopping || generation != seenGeneration; 
+		});
+		if (isStopping) {
+			return;
+		}
+		seenGeneration = generation;
+		RunTasks(lock);
+	}
+}
+
+void WorkerPool::RunTasks(std::unique_lock<std::mutex>& lock)
+{
+	while (job != nullptr && nextTask < numberOfTasks) {
+		std::size_t task = nextTask++;
+		const std::function<void(std::size_t)>& current = *job;
+		lock.unlock();
+		current(task);
+		lock.lock();
+		numberOfFinishedTasks++;
+		if (numberOfFinishedTasks == numberOfTasks) {
+			workDone.notify_all();
+		}
+	}
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Threads that stay alive between frames and run parallel loops. The
+// calling thread works too, so a pool of 0 threads runs loops inline.
+class WorkerPool
+{
+private:
+	std::vector<std::thread> threads;
+	std::mutex mutex;
+	std::condition_variable workReady;
+	std::condition_variable workDone;
+	// The loop being run and how far it has got
+	const std::function<void(std::size_t)>* job;
+	std::size_t numberOfTasks;
+	std::size_t nextTask;
+	std::size_t numberOfFinishedTasks;
+	// Bumped for each loop so sleeping threads know there is new work
+	unsigned long long generation;
+	bool isStopping;
+
+public:
+	// By default one thread less than the hardware runs at once
+	WorkerPool(std::size_t numberOfThreads = DefaultNumberOfThreads());
+	~WorkerPool();
+
+	inline std::size_t GetNumberOfThreads() const { return threads.size(); }
+	static std::size_t DefaultNumberOfThreads();
+
+	// Calls job(i) for every i below count and returns once all are done
+	void ParallelFor(std::size_t count, const std::function<void(std::size_t)>& job);
+
+private:
+	void WorkerLoop();
+	// Takes tasks until none are left; the lock is released while running
+	void RunTasks(std::unique_lock<std::mutex>& lock);
+};
@@ -0,0 +1,18 @@
+#version 430
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 color;
+out vec4 fragColor;
+layout(std140, binding = 0) uniform FrameUniforms {
+    mat4 view;
+    mat4 projection;
+    vec4 viewport;
+    float time;
+};
+layout(std140, binding = 1) uniform ObjectUniforms {
+    mat4 world;
+};
+void main()
+{
+gl_Position = projection * view * world * vec4(position, 1.0);
+fragColor = vec4(color, 1.0);
+}
@@ -1,12 +1,16 @@
 #version 430
 layout(location = 0) in vec3 position;
 layout(location = 1) in vec3 color;
+layout(location = 12) in mat4 instanceWorld;
 out vec4 fragColor;
-uniform mat4 world;
-uniform mat4 view;
-uniform mat4 projection;
+layout(std140, binding = 0) uniform FrameUniforms {
+    mat4 view;
+    mat4 projection;
+    vec4 viewport;
+    float time;
+};
 void main()
 {
-gl_Position = projection * view * world * vec4(position, 1.0);
+gl_Position = projection * view * instanceWorld * vec4(position, 1.0);
 fragColor = vec4(color, 1.0);
 }